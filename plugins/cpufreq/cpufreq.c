@@ -33,6 +33,8 @@
 
 #include "plugin.h"
 #include "misc.h"
+#include "sampler.h"
+#include "metrics.h"
 
 #include "dbg.h"
 
@@ -46,6 +48,8 @@
 #define SCALING_MAX         "scaling_max_freq"
 #define SCALING_MIN         "scaling_min_freq"
 
+#define UPDATE_PERIOD       2000 /* ms */
+
 
 typedef struct {
     GtkWidget *main;
@@ -56,6 +60,7 @@ typedef struct {
     int has_cpufreq;
     char* cur_governor;
     int   cur_freq;
+    char *freq_path;
     unsigned int timer;
     //gboolean remember;
 } cpufreq;
@@ -67,40 +72,34 @@ typedef struct {
 
 static void cpufreq_destructor(gpointer user_data);
 
+/* Values are read through the shared sampler which keeps files open and
+   reuses readings made within the same update period. */
 static void
 get_cur_governor(cpufreq *cf){
-    FILE *fp;
-    char buf[ 100 ], sstmp [ 256 ];
+    const LXPanelSample *sample;
+    char sstmp [ 256 ];
 
+    if (cf->cpus == NULL)
+        return;
     snprintf(sstmp, sizeof(sstmp), "%s/%s", (char*)cf->cpus->data, SCALING_GOV);
-    if ((fp = fopen( sstmp, "r")) != NULL) {
-        if(cf->cur_governor)
-        {
-          g_free(cf->cur_governor);
-          cf->cur_governor = NULL;
-        }
-        if (fgets(buf, 100, fp))
-        {
-            buf[strlen(buf)-1] = '\0';
-            cf->cur_governor = strdup(buf);
-        }
-        fclose(fp);
+    sample = lxpanel_sampler_read(LXPANEL_SAMPLE_TEXT, sstmp, UPDATE_PERIOD / 2);
+    if (sample->valid) {
+        g_free(cf->cur_governor);
+        cf->cur_governor = g_strndup(sample->text, strcspn(sample->text, "\n"));
     }
 }
 
 static void
 get_cur_freq(cpufreq *cf){
-    FILE *fp;
-    char buf[ 100 ], sstmp [ 256 ];
+    const LXPanelSample *sample;
 
-    snprintf(sstmp, sizeof(sstmp), "%s/%s", (char*)cf->cpus->data, SCALING_CUR_FREQ);
-    if ((fp = fopen( sstmp, "r")) != NULL) {
-        if (fgets(buf, 100, fp))
-        {
-            buf[strlen(buf)-1] = '\0';
-            cf->cur_freq = atoi(buf);
-        }
-        fclose(fp);
+    if (cf->freq_path == NULL)
+        return;
+    sample = lxpanel_sampler_read(LXPANEL_SAMPLE_VALUE, cf->freq_path, UPDATE_PERIOD / 2);
+    if (sample->valid) {
+        cf->cur_freq = sample->value;
+        lxpanel_metrics_publish("cpufreq.freq", "MHz", sample->time,
+                                cf->cur_freq / 1000.0);
     }
 }
 
@@ -334,11 +333,9 @@ _update_tooltip(cpufreq *cf)
     RET(TRUE);
 }
 
-static gboolean update_tooltip(gpointer user_data)
+static void update_tooltip(const LXPanelSample *sample, gpointer user_data)
 {
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
-    return _update_tooltip(user_data);
+    _update_tooltip(user_data);
 }
 
 static GtkWidget *cpufreq_constructor(LXPanel *panel, config_setting_t *settings)
@@ -360,13 +357,21 @@ static GtkWidget *cpufreq_constructor(LXPanel *panel, config_setting_t *settings
     cf->has_cpufreq = 0;
 
     get_cpus(cf);
+    if (cf->cpus)
+        cf->freq_path = g_strdup_printf("%s/%s", (char*)cf->cpus->data, SCALING_CUR_FREQ);
 
     //if (config_setting_lookup_int(settings, "Remember", &tmp_int)) cf->remember = tmp_int != 0;
     //if (config_setting_lookup_int(settings, "Governor", &tmp_str)) cf->cur_governor = g_strdup(tmp_str);
     //config_setting_lookup_int(settings, "Frequency", &cf->cur_freq);
 
     _update_tooltip(cf);
-    cf->timer = g_timeout_add_seconds(2, update_tooltip, (gpointer)cf);
+    /* sampler reads frequency right before calling update_tooltip() */
+    if (cf->freq_path)
+        cf->timer = lxpanel_sampler_subscribe(LXPANEL_SAMPLE_VALUE, cf->freq_path,
+                                              UPDATE_PERIOD, update_tooltip, cf);
+    else
+        cf->timer = lxpanel_sampler_subscribe(LXPANEL_SAMPLE_TICK, NULL,
+                                              UPDATE_PERIOD, update_tooltip, cf);
 
     RET(cf->main);
 }
@@ -395,7 +400,8 @@ cpufreq_destructor(gpointer user_data)
     cpufreq *cf = (cpufreq *)user_data;
     g_list_free ( cf->cpus );
     g_list_free ( cf->governors );
-    g_source_remove(cf->timer);
+    lxpanel_sampler_unsubscribe(cf->timer);
+    g_free(cf->freq_path);
     g_free(cf);
 }
 
@@ -418,5 +424,6 @@ LXPanelPluginInit fm_module_init_lxpanel_gtk = {
     .new_instance = cpufreq_constructor,
     //.config      = config,
     .button_press_event = clicked,
-    .reconfigure = cpufreq_reconfig
+    .reconfigure = cpufreq_reconfig,
+    .non_critical = TRUE
 };
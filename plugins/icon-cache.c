@@ -0,0 +1,144 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "icon-cache.h"
+
+/* number of entries kept in cache; entries which are in use by some button
+   are never evicted, so it limits only number of unused ones */
+#define ICON_CACHE_SIZE 32
+
+typedef struct {
+    guint64 hash;               /* hash of source image */
+    guint width, height;        /* requested size */
+    gboolean upscale;           /* if small image was scaled up */
+} IconCacheKey;
+
+typedef struct {
+    IconCacheKey key;
+    GdkPixbuf *pixbuf;
+} IconCacheEntry;
+
+static GHashTable *icon_cache = NULL; /* IconCacheKey -> GList in icon_lru */
+static GQueue icon_lru = G_QUEUE_INIT; /* IconCacheEntry, most recent first */
+
+static guint icon_cache_key_hash(gconstpointer p)
+{
+    const IconCacheKey *key = p;
+
+    return (guint)(key->hash ^ (key->hash >> 32)) ^ (key->width << 16) ^ key->height;
+}
+
+static gboolean icon_cache_key_equal(gconstpointer a, gconstpointer b)
+{
+    const IconCacheKey *ka = a, *kb = b;
+
+    return ka->hash == kb->hash && ka->width == kb->width &&
+           ka->height == kb->height && ka->upscale == kb->upscale;
+}
+
+static void icon_cache_entry_free(IconCacheEntry *entry)
+{
+    g_object_unref(entry->pixbuf);
+    g_slice_free(IconCacheEntry, entry);
+}
+
+/* drops least recently used entries which nobody else holds */
+static void icon_cache_evict(void)
+{
+    GList *l, *prev;
+
+    for (l = icon_lru.tail; l && icon_lru.length > ICON_CACHE_SIZE; l = prev)
+    {
+        IconCacheEntry *entry = l->data;
+
+        prev = l->prev;
+        if (G_OBJECT(entry->pixbuf)->ref_count > 1)
+            continue; /* still in use */
+        g_hash_table_remove(icon_cache, &entry->key);
+        g_queue_delete_link(&icon_lru, l);
+        icon_cache_entry_free(entry);
+    }
+}
+
+guint64 icon_cache_hash(const gulong *data, gulong width, gulong height)
+{
+    /* FNV-1a over lower 32 bits of each pixel */
+    guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+    gulong i, len = width * height;
+
+    hash = (hash ^ width) * G_GUINT64_CONSTANT(1099511628211);
+    hash = (hash ^ height) * G_GUINT64_CONSTANT(1099511628211);
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (guint32)data[i]) * G_GUINT64_CONSTANT(1099511628211);
+    return hash;
+}
+
+GdkPixbuf *icon_cache_lookup(guint64 hash, guint width, guint height,
+                             gboolean upscale)
+{
+    IconCacheKey key;
+    GList *l;
+
+    if (icon_cache == NULL)
+        return NULL;
+    key.hash = hash;
+    key.width = width;
+    key.height = height;
+    key.upscale = upscale;
+    l = g_hash_table_lookup(icon_cache, &key);
+    if (l == NULL)
+        return NULL;
+    /* move it to head of LRU */
+    g_queue_unlink(&icon_lru, l);
+    g_queue_push_head_link(&icon_lru, l);
+    return g_object_ref(((IconCacheEntry *)l->data)->pixbuf);
+}
+
+void icon_cache_insert(guint64 hash, guint width, guint height,
+                       gboolean upscale, GdkPixbuf *pixbuf)
+{
+    IconCacheEntry *entry;
+    GList *l;
+
+    g_return_if_fail(GDK_IS_PIXBUF(pixbuf));
+
+    if (icon_cache == NULL)
+        icon_cache = g_hash_table_new(icon_cache_key_hash, icon_cache_key_equal);
+    entry = g_slice_new0(IconCacheEntry);
+    entry->key.hash = hash;
+    entry->key.width = width;
+    entry->key.height = height;
+    entry->key.upscale = upscale;
+    l = g_hash_table_lookup(icon_cache, &entry->key);
+    if (l != NULL) /* replace old one */
+    {
+        IconCacheEntry *old = l->data;
+
+        g_hash_table_remove(icon_cache, &old->key);
+        g_queue_delete_link(&icon_lru, l);
+        icon_cache_entry_free(old);
+    }
+    entry->pixbuf = g_object_ref(pixbuf);
+    g_queue_push_head(&icon_lru, entry);
+    g_hash_table_insert(icon_cache, &entry->key, icon_lru.head);
+    icon_cache_evict();
+}
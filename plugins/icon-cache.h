@@ -0,0 +1,43 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __ICON_CACHE_H__
+#define __ICON_CACHE_H__ 1
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+/* Process-wide cache of scaled window icons, shared by all task buttons.
+   Icons are addressed by hash of raw _NET_WM_ICON image and the size they
+   were scaled to, so windows with the same icon share the same pixbuf. */
+
+/* computes hash of width x height ARGB image as returned by X server */
+guint64 icon_cache_hash(const gulong *data, gulong width, gulong height);
+
+/* returns new reference to cached pixbuf or NULL if there is none */
+GdkPixbuf *icon_cache_lookup(guint64 hash, guint width, guint height,
+                             gboolean upscale);
+
+/* adds pixbuf into cache, cache adds own reference on it */
+void icon_cache_insert(guint64 hash, guint width, guint height,
+                       gboolean upscale, GdkPixbuf *pixbuf);
+
+G_END_DECLS
+
+#endif
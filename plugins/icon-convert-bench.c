@@ -0,0 +1,92 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Times the scalar icon conversion against each vector variant built for
+   this CPU on square icons of typical sizes.
+
+   Usage: icon-convert-bench [pixels per size and variant, in millions] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* static variants are timed directly */
+#include "icon-convert.c"
+
+static const guint sizes[] = { 16, 24, 32, 48, 64, 128, 256 };
+
+#define MAX_PIXELS (256 * 256)
+
+static gulong src[MAX_PIXELS];
+static guchar dst[MAX_PIXELS * 4];
+
+static double time_variant(IconConvertFunc func, gulong len, guint64 pixels)
+{
+    guint64 i, rounds = MAX(pixels / len, 1);
+    gint64 time;
+
+    func(src, dst, len);
+    time = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++)
+        func(src, dst, len);
+    time = g_get_monotonic_time() - time;
+    /* nanoseconds per icon */
+    return (double)time * 1000 / rounds;
+}
+
+static void run(const char *name, IconConvertFunc func, guint64 pixels)
+{
+    guint i;
+
+    printf("%-9s", name);
+    for (i = 0; i < G_N_ELEMENTS(sizes); i++)
+        printf(" %9.0f", time_variant(func, sizes[i] * sizes[i], pixels));
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    guint64 pixels = (argc > 1 ? atoi(argv[1]) : 64) * (guint64)1000000;
+    guint i;
+
+    if (pixels == 0)
+    {
+        fprintf(stderr, "usage: %s [millions of pixels]\n", argv[0]);
+        return 2;
+    }
+    for (i = 0; i < G_N_ELEMENTS(src); i++)
+        src[i] = (i * 2654435761u) ^ ((gulong)i << 7);
+
+    printf("ns/icon  ");
+    for (i = 0; i < G_N_ELEMENTS(sizes); i++)
+        printf(" %5ux%-3u", sizes[i], sizes[i]);
+    printf("\n");
+    run("scalar", argb_to_rgba_c, pixels);
+#ifdef ICON_CONVERT_SSE2
+    run("sse2", argb_to_rgba_sse2, pixels);
+#endif
+#ifdef ICON_CONVERT_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        run("avx2", argb_to_rgba_avx2, pixels);
+#endif
+#ifdef ICON_CONVERT_NEON
+    run("neon", argb_to_rgba_neon, pixels);
+#endif
+    run("dispatch", icon_argb_to_rgba, pixels);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Checks every vector variant of the icon conversion built for this CPU
+   against the scalar one, bit for bit, for all lengths up to MAX_LEN so
+   that each vector width and every tail length is covered. */
+
+#include <stdio.h>
+#include <string.h>
+
+/* static variants are tested directly */
+#include "icon-convert.c"
+
+#define MAX_LEN 300
+
+static gulong src[MAX_LEN + 1];
+static guchar expected[MAX_LEN * 4 + 1];
+static guchar result[MAX_LEN * 4 + 1];
+
+static guint32 rand_state = 0x12345678;
+
+static guint32 next_random(void)
+{
+    /* xorshift, so the data are the same on every run */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static int check_variant(const char *name, IconConvertFunc func)
+{
+    gulong len, offset;
+    int failed = 0;
+
+    /* offset 1 makes both source and destination unaligned */
+    for (offset = 0; offset < 2; offset++)
+        for (len = 0; len < MAX_LEN; len++)
+        {
+            argb_to_rgba_c(src + offset, expected + offset, len);
+            /* guard byte after the end must stay untouched */
+            memset(result, 0xa5, sizeof(result));
+            func(src + offset, result + offset, len);
+            if (memcmp(expected + offset, result + offset, len * 4) != 0 ||
+                result[offset + len * 4] != 0xa5)
+            {
+                fprintf(stderr, "%s: mismatch for length %lu, offset %lu\n",
+                        name, len, offset);
+                failed = 1;
+            }
+        }
+    printf("%s: %s\n", name, failed ? "FAIL" : "ok");
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(src); i++)
+    {
+        src[i] = next_random();
+#if GLIB_SIZEOF_LONG == 8
+        /* upper half of each long is not part of the pixel */
+        src[i] |= (gulong)next_random() << 32;
+#endif
+    }
+
+#ifdef ICON_CONVERT_SSE2
+    failed |= check_variant("sse2", argb_to_rgba_sse2);
+#endif
+#ifdef ICON_CONVERT_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        failed |= check_variant("avx2", argb_to_rgba_avx2);
+    else
+        printf("avx2: skipped, not supported by this CPU\n");
+#endif
+#ifdef ICON_CONVERT_NEON
+    failed |= check_variant("neon", argb_to_rgba_neon);
+#endif
+    failed |= check_variant("dispatch", icon_argb_to_rgba);
+
+    return failed;
+}
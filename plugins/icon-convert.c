@@ -0,0 +1,171 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "icon-convert.h"
+
+/* Vector variants below work on little endian only since they treat the
+   pixel as 32-bit value 0xAARRGGBB and swap red and blue bytes in place. */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+# if defined(__SSE2__)
+#  define ICON_CONVERT_SSE2 1
+#  include <emmintrin.h>
+#  if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#   define ICON_CONVERT_AVX2 1
+#   include <immintrin.h>
+#  endif
+# elif defined(__aarch64__) || defined(__ARM_NEON)
+#  define ICON_CONVERT_NEON 1
+#  include <arm_neon.h>
+# endif
+#endif
+
+typedef void (*IconConvertFunc)(const gulong *src, guchar *dst, gulong len);
+
+static void argb_to_rgba_c(const gulong *src, guchar *dst, gulong len)
+{
+    gulong i;
+
+    for (i = 0; i < len; dst += 4, i += 1)
+    {
+        guint argb = src[i];
+        guint rgba = (argb << 8) | (argb >> 24);
+        dst[0] = rgba >> 24;
+        dst[1] = (rgba >> 16) & 0xff;
+        dst[2] = (rgba >> 8) & 0xff;
+        dst[3] = rgba & 0xff;
+    }
+}
+
+#ifdef ICON_CONVERT_SSE2
+static void argb_to_rgba_sse2(const gulong *src, guchar *dst, gulong len)
+{
+    const __m128i mask_ag = _mm_set1_epi32((int)0xff00ff00);
+    __m128i v, ag, rb;
+    gulong i;
+
+    for (i = 0; i + 4 <= len; i += 4)
+    {
+#if GLIB_SIZEOF_LONG == 8
+        /* take lower 32 bits of each of 4 longs */
+        __m128i lo = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(src + i + 2));
+        lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+        hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+        v = _mm_unpacklo_epi64(lo, hi);
+#else
+        v = _mm_loadu_si128((const __m128i *)(src + i));
+#endif
+        ag = _mm_and_si128(v, mask_ag);
+        rb = _mm_andnot_si128(mask_ag, v);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_or_si128(ag, rb));
+    }
+    argb_to_rgba_c(src + i, dst + i * 4, len - i);
+}
+#endif
+
+#ifdef ICON_CONVERT_AVX2
+__attribute__((target("avx2")))
+static void argb_to_rgba_avx2(const gulong *src, guchar *dst, gulong len)
+{
+    const __m256i mask_ag = _mm256_set1_epi32((int)0xff00ff00);
+#if GLIB_SIZEOF_LONG == 8
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+#endif
+    __m256i v, ag, rb;
+    gulong i;
+
+    for (i = 0; i + 8 <= len; i += 8)
+    {
+#if GLIB_SIZEOF_LONG == 8
+        /* take lower 32 bits of each of 8 longs */
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(src + i + 4));
+        lo = _mm256_permutevar8x32_epi32(lo, pack);
+        hi = _mm256_permutevar8x32_epi32(hi, pack);
+        v = _mm256_permute2x128_si256(lo, hi, 0x20);
+#else
+        v = _mm256_loadu_si256((const __m256i *)(src + i));
+#endif
+        ag = _mm256_and_si256(v, mask_ag);
+        rb = _mm256_andnot_si256(mask_ag, v);
+        rb = _mm256_or_si256(_mm256_slli_epi32(rb, 16), _mm256_srli_epi32(rb, 16));
+        _mm256_storeu_si256((__m256i *)(dst + i * 4), _mm256_or_si256(ag, rb));
+    }
+    argb_to_rgba_sse2(src + i, dst + i * 4, len - i);
+}
+#endif
+
+#ifdef ICON_CONVERT_NEON
+static void argb_to_rgba_neon(const gulong *src, guchar *dst, gulong len)
+{
+    const uint32x4_t mask_ag = vdupq_n_u32(0xff00ff00);
+    uint32x4_t v, ag, rb;
+    gulong i;
+
+    for (i = 0; i + 4 <= len; i += 4)
+    {
+#if GLIB_SIZEOF_LONG == 8
+        /* deinterleave 4 longs, lower halves get into val[0] */
+        uint32x4x2_t pair = vld2q_u32((const uint32_t *)(src + i));
+        v = pair.val[0];
+#else
+        v = vld1q_u32((const uint32_t *)(src + i));
+#endif
+        ag = vandq_u32(v, mask_ag);
+        rb = vbicq_u32(v, mask_ag);
+        rb = vorrq_u32(vshlq_n_u32(rb, 16), vshrq_n_u32(rb, 16));
+        vst1q_u8(dst + i * 4, vreinterpretq_u8_u32(vorrq_u32(ag, rb)));
+    }
+    argb_to_rgba_c(src + i, dst + i * 4, len - i);
+}
+#endif
+
+static IconConvertFunc icon_convert_select(void)
+{
+#ifdef ICON_CONVERT_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        g_debug("icon-convert: using AVX2");
+        return argb_to_rgba_avx2;
+    }
+#endif
+#if defined(ICON_CONVERT_SSE2)
+    g_debug("icon-convert: using SSE2");
+    return argb_to_rgba_sse2;
+#elif defined(ICON_CONVERT_NEON)
+    g_debug("icon-convert: using NEON");
+    return argb_to_rgba_neon;
+#else
+    return argb_to_rgba_c;
+#endif
+}
+
+void icon_argb_to_rgba(const gulong *src, guchar *dst, gulong len)
+{
+    static gsize convert = 0;
+
+    if (g_once_init_enter(&convert))
+        g_once_init_leave(&convert, (gsize)icon_convert_select());
+    ((IconConvertFunc)convert)(src, dst, len);
+}
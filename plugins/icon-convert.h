@@ -0,0 +1,34 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __ICON_CONVERT_H__
+#define __ICON_CONVERT_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* converts len pixels of _NET_WM_ICON data (ARGB in the lower 32 bits of
+   each long) into RGBA bytes as used by GdkPixbuf, dst should have space
+   for len * 4 bytes; best implementation for the CPU is chosen on first
+   call */
+void icon_argb_to_rgba(const gulong *src, guchar *dst, gulong len);
+
+G_END_DECLS
+
+#endif
@@ -78,6 +78,7 @@
 #include "plugin.h"
 #include "task-button.h"
 #include "launch-button.h"
+#include "task-cmdline.h"
 #include "icon-grid.h"
 #ifndef DISABLE_MENU
 # include "menu-policy.h"
@@ -128,9 +129,16 @@ struct LaunchTaskBarPlugin {
     int spacing;                   /* Spacing between taskbar buttons */
     guint flash_timeout;        /* Timer for urgency notification */
     gboolean flash_state;       /* One-bit counter to flash taskbar */
+    Window *client_list;        /* Sorted copy of last NET_CLIENT_LIST */
+    int client_count;           /* Number of windows in client_list */
     /* COMMON */
 #ifndef DISABLE_MENU
     FmPath * path;              /* Current menu item path */
+    MenuCache *mc;              /* Menu cache for apps index */
+    gpointer mc_reload_notify;  /* Reload notify handle for mc */
+    GHashTable *app_by_id;      /* Desktop id stem -> FmPath */
+    GHashTable *app_by_exec;    /* Short exec name -> FmPath */
+    GHashTable *app_by_path;    /* Absolute exec path -> FmPath */
     GtkWidget       *p_menuitem_lock_tbp;
     GtkWidget       *p_menuitem_unlock_tbp;
     GtkWidget       *p_menuitem_new_instance;
@@ -145,6 +153,7 @@ struct LaunchTaskBarPlugin {
     GtkWidget       *p_notebook_page_launch;
     GtkWidget       *p_notebook_page_task;
     GKeyFile        *p_key_file_special_cases;
+    TaskCmdlineCache *cmdline_cache;    /* resolved executables by pid */
     int              mode;
     gboolean         lb_built;
     gboolean         tb_built;
@@ -191,112 +200,126 @@ static void taskbar_add_task_button(LaunchTaskBarPlugin * tb, TaskButton * task)
 #ifndef DISABLE_MENU
 static char *task_get_cmdline(Window win, LaunchTaskBarPlugin *ltbp)
 {
-    GPid pid = get_net_wm_pid(win);
-    char proc_path[64];
-    gchar *cmdline = NULL;
-    gchar *p_char = NULL;
+    return task_cmdline_cache_lookup(ltbp->cmdline_cache, get_net_wm_pid(win));
+}
 
-    snprintf(proc_path, sizeof(proc_path),
-             G_DIR_SEPARATOR_S "proc" G_DIR_SEPARATOR_S "%lu" G_DIR_SEPARATOR_S "cmdline",
-             (gulong)pid);
-    g_file_get_contents(proc_path, &cmdline, NULL, NULL);
-    if (cmdline)
-    {
-        p_char = strchr(cmdline, '\n');
-        if(p_char != NULL) *p_char = '\0';
-        p_char = strrchr(cmdline, G_DIR_SEPARATOR);
-        if (p_char != NULL) p_char++;
-        else p_char = cmdline;
-        if(strcmp(p_char, "python") == 0)
-        {
-            snprintf(proc_path, sizeof(proc_path),
-                     G_DIR_SEPARATOR_S "proc" G_DIR_SEPARATOR_S "%lu" G_DIR_SEPARATOR_S "comm",
-                     (gulong)pid);
-            g_free(cmdline);
-            cmdline = NULL;
-            g_file_get_contents(proc_path, &cmdline, NULL, NULL);
-            if (cmdline)
-            {
-                p_char = strchr(cmdline, '\n');
-                if(p_char != NULL) *p_char = '\0';
-            }
-        }
-        else
-        {
-            p_char = g_key_file_get_string(ltbp->p_key_file_special_cases,
-                                           "special_cases", p_char, NULL);
-            if (p_char != NULL) /* found this key */
-            {
-                g_free(cmdline);
-                cmdline = p_char;
-            }
-        }
-    }
-    return cmdline;
+/* Index of applications in menu cache so task can find its desktop entry
+   without scanning all the apps each time. It is dropped on menu cache
+   reload and rebuilt on next lookup. */
+static void app_index_add_key(GHashTable *index, const char *key, gsize len,
+                              FmPath *path)
+{
+    char *str = g_strndup(key, len);
+
+    /* the first application in the list wins, the same as with scan */
+    if (g_hash_table_lookup(index, str) == NULL)
+        g_hash_table_insert(index, str, fm_path_ref(path));
+    else
+        g_free(str);
 }
 
-static FmPath *f_find_menu_launchbutton_recursive(Window win, LaunchTaskBarPlugin *ltbp)
+/* adds every prefix of str followed by sep, and also whole str if asked */
+static void app_index_add(GHashTable *index, const char *str, char sep,
+                          gboolean whole, FmPath *path)
+{
+    const char *p;
+
+    for (p = strchr(str, sep); p != NULL; p = strchr(p + 1, sep))
+        app_index_add_key(index, str, p - str, path);
+    if (whole)
+        app_index_add_key(index, str, strlen(str), path);
+}
+
+static void launchtaskbar_app_index_free(LaunchTaskBarPlugin *ltbp)
+{
+    if (ltbp->app_by_id == NULL)
+        return;
+    g_hash_table_destroy(ltbp->app_by_id);
+    g_hash_table_destroy(ltbp->app_by_exec);
+    g_hash_table_destroy(ltbp->app_by_path);
+    ltbp->app_by_id = ltbp->app_by_exec = ltbp->app_by_path = NULL;
+}
+
+static void launchtaskbar_app_index_reload(MenuCache *mc, gpointer user_data)
+{
+    launchtaskbar_app_index_free(user_data);
+}
+
+static void launchtaskbar_app_index_build(LaunchTaskBarPlugin *ltbp)
 {
-    MenuCache *mc;
     guint32 flags;
     GSList *apps, *l;
-    size_t len;
-    char *exec_bin = task_get_cmdline(win, ltbp);
-    const char *exec, *short_exec;
+    const char *exec;
     char *str_path;
-    FmPath *path = NULL;
+    FmPath *path;
 
-    /* FIXME: cache it in Task object */
-    mc = panel_menu_cache_new(&flags);
-    /* FIXME: if menu plugin wasn't loaded yet we'll get NULL list here */
-    apps = menu_cache_list_all_apps(mc);
-    short_exec = strrchr(exec_bin, '/');
-    if (short_exec != NULL)
-        short_exec++;
-    else
-        short_exec = exec_bin;
-    len = strlen(short_exec);
-    /* the same executable may be used in numerous applications so wild guess
-       estimation check for desktop id equal to short_exec+".desktop" first */
-    for (l = apps; l; l = l->next)
-    {
-        exec = menu_cache_item_get_id(MENU_CACHE_ITEM(l->data));
-        /* we don't check flags here because user always can manually
-           start any app that isn't visible in the desktop menu */
-        if (strncmp(exec, short_exec, len) == 0 && exec[len] == '.')
-            break;
-    }
-    /* if not found then check for non-absolute exec name in application
-       since it usually is expanded by application starting functions */
-    if (l == NULL) for (l = apps; l; l = l->next)
+    if (ltbp->mc == NULL)
     {
-        exec = menu_cache_app_get_exec(MENU_CACHE_APP(l->data));
-        if (exec && exec[0] != '/' && strncmp(exec, short_exec, len) == 0 &&
-            (exec[len] == ' ' || exec[len] == 0))
-            break;
-    }
-    /* well, not matched, let try full path, we assume here if application
-       starts executable by full path then process cannot have short name */
-    if (l == NULL && exec_bin[0] == '/')
-    {
-        len = strlen(exec_bin);
-        for (l = apps; l; l = l->next)
-        {
-            exec = menu_cache_app_get_exec(MENU_CACHE_APP(l->data));
-            if (exec && exec[0] == '/' && strncmp(exec, exec_bin, len) == 0 &&
-                (exec[len] == ' ' || exec[len] == 0))
-                break;
-        }
+        ltbp->mc = panel_menu_cache_new(&flags);
+        if (ltbp->mc == NULL)
+            return;
+        ltbp->mc_reload_notify = menu_cache_add_reload_notify(ltbp->mc,
+                                        launchtaskbar_app_index_reload, ltbp);
     }
-    if (l)
+    ltbp->app_by_id = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify)fm_path_unref);
+    ltbp->app_by_exec = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)fm_path_unref);
+    ltbp->app_by_path = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)fm_path_unref);
+    /* if menu cache isn't loaded yet we'll get NULL list here but the
+       index will be rebuilt after reload */
+    apps = menu_cache_list_all_apps(ltbp->mc);
+    for (l = apps; l; l = l->next)
     {
         str_path = menu_cache_dir_make_path(MENU_CACHE_DIR(l->data));
         path = fm_path_new_relative(fm_path_get_apps_menu(), str_path+13); /* skip /Applications */
         g_free(str_path);
+        /* the same executable may be used in numerous applications so wild
+           guess estimation: desktop id equal to short_exec+".desktop" */
+        app_index_add(ltbp->app_by_id, menu_cache_item_get_id(MENU_CACHE_ITEM(l->data)),
+                      '.', FALSE, path);
+        /* non-absolute exec name is usually expanded by application
+           starting functions, absolute one is kept by process as is */
+        exec = menu_cache_app_get_exec(MENU_CACHE_APP(l->data));
+        if (exec)
+            app_index_add(exec[0] == '/' ? ltbp->app_by_path : ltbp->app_by_exec,
+                          exec, ' ', TRUE, path);
+        fm_path_unref(path);
     }
     g_slist_foreach(apps, (GFunc)menu_cache_item_unref, NULL);
     g_slist_free(apps);
-    menu_cache_unref(mc);
+}
+
+static FmPath *f_find_menu_launchbutton_recursive(Window win, LaunchTaskBarPlugin *ltbp)
+{
+    char *exec_bin = task_get_cmdline(win, ltbp);
+    const char *short_exec;
+    FmPath *path = NULL;
+
+    if (exec_bin == NULL)
+        return NULL;
+    if (ltbp->app_by_id == NULL)
+        launchtaskbar_app_index_build(ltbp);
+    short_exec = strrchr(exec_bin, '/');
+    if (short_exec != NULL)
+        short_exec++;
+    else
+        short_exec = exec_bin;
+    /* we don't check flags here because user always can manually
+       start any app that isn't visible in the desktop menu */
+    if (ltbp->app_by_id != NULL)
+    {
+        path = g_hash_table_lookup(ltbp->app_by_id, short_exec);
+        if (path == NULL)
+            path = g_hash_table_lookup(ltbp->app_by_exec, short_exec);
+        /* well, not matched, let try full path, we assume here if application
+           starts executable by full path then process cannot have short name */
+        if (path == NULL && exec_bin[0] == '/')
+            path = g_hash_table_lookup(ltbp->app_by_path, exec_bin);
+        if (path != NULL)
+            fm_path_ref(path);
+    }
     g_debug("f_find_menu_launchbutton_recursive: search '%s' found=%d", exec_bin, (path != NULL));
     g_free(exec_bin);
     return path;
@@ -1145,6 +1168,7 @@ static GtkWidget *_launchtaskbar_constructor(LXPanel *panel, config_setting_t *s
         }
     }
     g_free(special_cases_filepath);
+    ltbp->cmdline_cache = task_cmdline_cache_new(ltbp->p_key_file_special_cases);
 
     /* Allocate top level widget and set into Plugin widget pointer. */
     ltbp->plugin = p = panel_box_new(panel, FALSE, 5);
@@ -1216,6 +1240,12 @@ static void launchtaskbar_destructor_task(LaunchTaskBarPlugin *ltbp)
 #ifndef DISABLE_MENU
     if (ltbp->path)
         fm_path_unref(ltbp->path);
+    launchtaskbar_app_index_free(ltbp);
+    if (ltbp->mc)
+    {
+        menu_cache_remove_reload_notify(ltbp->mc, ltbp->mc_reload_notify);
+        menu_cache_unref(ltbp->mc);
+    }
 #endif
 
     /* DND delay handler */
@@ -1226,6 +1256,8 @@ static void launchtaskbar_destructor_task(LaunchTaskBarPlugin *ltbp)
     }
     if (ltbp->dnd_delay_task)
         g_object_remove_weak_pointer(G_OBJECT(ltbp->dnd_delay_task), (gpointer *)&ltbp->dnd_delay_task);
+
+    g_free(ltbp->client_list);
 }
 
 /* Plugin destructor. */
@@ -1242,6 +1274,8 @@ static void launchtaskbar_destructor(gpointer user_data)
     // LAUNCHTASKBAR
 
     /* Deallocate all memory. */
+    if (ltbp->cmdline_cache != NULL)
+        task_cmdline_cache_free(ltbp->cmdline_cache);
     if (ltbp->p_key_file_special_cases != NULL)
         g_key_file_free(ltbp->p_key_file_special_cases);
     g_free(ltbp);
@@ -1993,18 +2027,7 @@ static char *task_get_class(Window win)
 /* Look up a task in the task list. */
 static TaskButton *task_lookup(LaunchTaskBarPlugin * tb, Window win)
 {
-    TaskButton *task = NULL;
-    GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
-    GList *l;
-
-    for (l = children; l; l = l->next)
-        if (task_button_has_window(l->data, win))
-        {
-            task = l->data;
-            break;
-        }
-    g_list_free(children);
-    return task;
+    return task_button_find_window(tb->tb_icon_grid, win);
 }
 
 
@@ -2214,8 +2237,8 @@ static void taskbar_add_task_button(LaunchTaskBarPlugin * tb, TaskButton * task)
                            G_CALLBACK(taskbar_button_enter), tb);
 }
 
-/* add win to tb, using list of task buttons */
-static void taskbar_add_new_window(LaunchTaskBarPlugin * tb, Window win, GList *list)
+/* add win to tb, using list of task buttons, returns new button if created */
+static TaskButton *taskbar_add_new_window(LaunchTaskBarPlugin * tb, Window win, GList *list)
 {
     gchar *res_class = task_get_class(win);
     TaskButton *task;
@@ -2226,11 +2249,42 @@ static void taskbar_add_new_window(LaunchTaskBarPlugin * tb, Window win, GList *
         if (task_button_add_window(list->data, win, res_class))
             break;
     if (list != NULL)
-        return; /* some button accepted it, done */
+        return NULL; /* some button accepted it, done */
 
     task = task_button_new(win, tb->current_desktop, tb->number_of_desktops,
                            tb->panel, res_class, tb->flags);
     taskbar_add_task_button(tb, task);
+    return task;
+}
+
+/* add win to tb if its state and type allow it to be in task list */
+static TaskButton *taskbar_try_new_window(LaunchTaskBarPlugin * tb, Window win, GList *list)
+{
+    NetWMWindowType nwwt;
+    NetWMState nws;
+
+    /* Evaluate window state and window type to see if it should be in task list. */
+    get_net_wm_state(win, &nws);
+    get_net_wm_window_type(win, &nwwt);
+    if (!accept_net_wm_state(&nws) || !accept_net_wm_window_type(&nwwt))
+        return NULL;
+    /* Allocate and initialize new task structure. */
+    return taskbar_add_new_window(tb, win, list);
+}
+
+static int window_compare(const void *a, const void *b)
+{
+    Window wa = *(const Window *)a, wb = *(const Window *)b;
+
+    return (wa < wb) ? -1 : (wa > wb);
+}
+
+/* test if window is in last NET_CLIENT_LIST */
+static gboolean taskbar_has_client(LaunchTaskBarPlugin * tb, Window win)
+{
+    return tb->client_count > 0 &&
+           bsearch(&win, tb->client_list, tb->client_count, sizeof(Window),
+                   window_compare) != NULL;
 }
 
 /*****************************************************
@@ -2248,48 +2302,72 @@ static void taskbar_net_client_list(GtkWidget * widget, LaunchTaskBarPlugin * tb
     Window * client_list = get_xaproperty(GDK_ROOT_WINDOW(), a_NET_CLIENT_LIST, XA_WINDOW, &client_count);
     if (client_list != NULL)
     {
-        GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid)), *l;
-        /* Remove windows from the task list that are not present in the NET_CLIENT_LIST. */
-        for (l = children; l; l = l->next)
-            task_button_update_windows_list(l->data, client_list, client_count);
-        g_list_free(children);
-        children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
-        /* Loop over client list, correlating it with task list. */
-        int i;
-        for (i = 0; i < client_count; i++)
+        GList *children = NULL;
+        TaskButton *task;
+        Window *sorted, *added;
+        int i, j, n_added = 0;
+
+        /* Compare sorted list with the previous one, so we touch only
+           windows which were added or removed since last event. */
+        sorted = g_memdup(client_list, client_count * sizeof(Window));
+        qsort(sorted, client_count, sizeof(Window), window_compare);
+        added = g_new(Window, client_count + 1);
+        for (i = j = 0; i < client_count || j < tb->client_count; )
         {
-            /* Search for the window in the task list.  Set up context to do an insert right away if needed. */
-            for (l = children; l; l = l->next)
+            if (j >= tb->client_count ||
+                (i < client_count && sorted[i] < tb->client_list[j]))
+                added[n_added++] = sorted[i++];
+            else if (i >= client_count || sorted[i] > tb->client_list[j])
             {
-                if (task_button_has_window(l->data, client_list[i]))
-                    break;
+                /* Remove window from the task list, it is not present in the NET_CLIENT_LIST. */
+                Window win = tb->client_list[j++];
+
+                task = task_lookup(tb, win);
+                if (task != NULL)
+                    task_button_window_deleted(task, win);
+                xprop_cache_forget(win);
             }
+            else
+                i++, j++;
+        }
+        g_free(tb->client_list);
+        tb->client_list = sorted;
+        tb->client_count = client_count;
 
-            /* Task is not in task list. */
-            if (l == NULL)
+        if (n_added > 0)
+        {
+            /* Fetch properties of new windows in one pass so we don't do a
+               round trip to X server for each of them below. */
+            xprop_cache_prefetch(added, n_added);
+            children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+            /* Loop over client list to keep stacking order of new windows. */
+            for (i = 0; i < client_count; i++)
             {
-                /* Evaluate window state and window type to see if it should be in task list. */
-                NetWMWindowType nwwt;
-                NetWMState nws;
-                get_net_wm_state(client_list[i], &nws);
-                get_net_wm_window_type(client_list[i], &nwwt);
-                if ((accept_net_wm_state(&nws))
-                && (accept_net_wm_window_type(&nwwt)))
+                if (bsearch(&client_list[i], added, n_added, sizeof(Window),
+                            window_compare) == NULL)
+                    continue;
+                /* Task is not in task list. */
+                if (task_lookup(tb, client_list[i]) == NULL)
                 {
-                    /* Allocate and initialize new task structure. */
-                    taskbar_add_new_window(tb, client_list[i], children);
-                    g_list_free(children);
-                    children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+                    task = taskbar_try_new_window(tb, client_list[i], children);
+                    if (task != NULL)
+                        children = g_list_append(children, task);
                 }
             }
+            g_list_free(children);
         }
-        g_list_free(children);
+        g_free(added);
         XFree(client_list);
     }
 
     else /* clear taskbar */
+    {
         gtk_container_foreach(GTK_CONTAINER(tb->tb_icon_grid),
                               (GtkCallback)gtk_widget_destroy, NULL);
+        g_free(tb->client_list);
+        tb->client_list = NULL;
+        tb->client_count = 0;
+    }
 }
 
 /* Handler for "current-desktop" event from root window listener. */
@@ -2344,7 +2422,18 @@ static void taskbar_property_notify_event(LaunchTaskBarPlugin *tb, XEvent *ev)
         {
             /* Look up task structure by X window handle. */
             TaskButton * tk = task_lookup(tb, win);
-            if (tk != NULL)
+            if (tk == NULL && (at == a_NET_WM_STATE || at == a_NET_WM_WINDOW_TYPE)
+                && taskbar_has_client(tb, win))
+            {
+                /* Window was not accepted before but may be accepted now. */
+                XErrorHandler previous_error_handler = XSetErrorHandler(panel_handle_x_error_swallow_BadWindow_BadDrawable);
+                GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+
+                taskbar_try_new_window(tb, win, children);
+                g_list_free(children);
+                XSetErrorHandler(previous_error_handler);
+            }
+            else if (tk != NULL)
             {
                 /* Install an error handler that ignores BadWindow.
                  * We frequently get a PropertyNotify event on deleted windows. */
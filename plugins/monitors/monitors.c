@@ -38,13 +38,15 @@
 /*
  * HOWTO : Add your own monitor for the resource "foo".
  *
- * 1) Write the foo_update() function, that fills in the stats.
+ * 1) Write the foo_update() function, that fills in the stats from a sample
+ *    of the shared sampler (see sampler.h).
  * 2) Write the foo_tooltip_update() function, that updates your tooltip. This
  *    is optional, but recommended.
  * 3) Add a #define FOO_POSITION, and increment N_MONITORS.
  * 4) Add :
  *     - the default color of your plugin ("default_colors" table)
  *     - the update function ("update_functions" table)
+ *     - the type of sample it needs ("sample_types" table)
  *     - the tooltip update function ("tooltip_update" table)
  * 5) Configuration :
  *     - edit the monitors_config() function so that a "Display FOO usage"
@@ -83,6 +85,8 @@
 #include <libfm/fm-gtk.h>
 
 #include "plugin.h"
+#include "sampler.h"
+#include "metrics.h"
 
 #include "dbg.h"
 
@@ -90,7 +94,7 @@
 #define PLUGIN_NAME      "MonitorsPlugin"
 #define BORDER_SIZE      2                  /* Pixels               */
 #define DEFAULT_WIDTH    40                 /* Pixels               */
-#define UPDATE_PERIOD    1                  /* Seconds              */
+#define UPDATE_PERIOD    1000               /* Milliseconds         */
 #define COLOR_SIZE       8                  /* In chars : #xxxxxx\0 */
 
 #ifndef ENTER
@@ -115,15 +119,20 @@ struct Monitor {
     gint         pixmap_width;      /* Width and size of the buffer           */
     gint         pixmap_height;     /* Does not include border size           */
     stats_set    *stats;            /* Circular buffer of values              */
+    gint         n_values;          /* Values per sample, as in CPU cores     */
     stats_set    total;             /* Maximum possible value, as in mem_total*/
     gint         ring_cursor;       /* Cursor for ring/circular buffer        */
     gchar        *color;            /* Color of the graph                     */
-    gboolean     (*update) (struct Monitor *); /* Update function             */
+    guint        sampler;           /* Subscription for samples               */
+    LXPanelCpuTicks previous_cpu;   /* Previous CPU sample for deltas         */
+    LXPanelCpuTicks *previous_cores;/* Previous per-core sample for deltas    */
+    gint         mode;              /* One of CPU_MODE_* for CPU monitor      */
+    gboolean     (*update) (struct Monitor *, const LXPanelSample *); /* Update function */
     void         (*update_tooltip) (struct Monitor *);
 };
 
 typedef struct Monitor Monitor;
-typedef gboolean (*update_func) (Monitor *);
+typedef gboolean (*update_func) (Monitor *, const LXPanelSample *);
 typedef void (*tooltip_update_func) (Monitor *);
 
 /*
@@ -135,6 +144,15 @@ typedef void (*tooltip_update_func) (Monitor *);
 #define MEM_POSITION    1
 #define N_MONITORS      2
 
+/*
+ * Ways to display the CPU monitor : total load of all cores, loads of each
+ * core stacked on each other, or a strip of one band per core whose brightness
+ * shows load of the core, so saturation of a single core is easy to spot.
+ */
+#define CPU_MODE_TOTAL      0
+#define CPU_MODE_STACKED    1
+#define CPU_MODE_HEATMAP    2
+
 /* Our plugin */
 typedef struct {
     LXPanel *panel;
@@ -142,7 +160,7 @@ typedef struct {
     Monitor  *monitors[N_MONITORS];          /* Monitors                      */
     int      displayed_monitors[N_MONITORS]; /* Booleans                      */
     char     *action;                        /* What to do on click           */
-    guint    timer;                          /* Timer for regular updates     */
+    int      cpu_mode;                       /* One of CPU_MODE_*             */
 } MonitorsPlugin;
 
 /*
@@ -151,11 +169,11 @@ typedef struct {
 static void monitor_set_foreground_color(MonitorsPlugin *, Monitor *, const gchar *);
 
 /* CPU Monitor */
-static gboolean cpu_update(Monitor *);
+static gboolean cpu_update(Monitor *, const LXPanelSample *);
 static void     cpu_tooltip_update (Monitor *m);
 
 /* RAM Monitor */
-static gboolean mem_update(Monitor *);
+static gboolean mem_update(Monitor *, const LXPanelSample *);
 static void     mem_tooltip_update (Monitor *m);
 
 
@@ -166,6 +184,7 @@ static gboolean expose_event(GtkWidget *, GdkEventExpose *, Monitor *);
 static gboolean draw(GtkWidget *, cairo_t *, Monitor *);
 #endif
 static void redraw_pixmap (Monitor *m);
+static void update_pixmap (Monitor *m, int x);
 
 /* Monitors functions */
 static void monitors_destructor(gpointer);
@@ -207,11 +226,14 @@ monitor_free(Monitor *m)
     if (!m)
         return;
 
+    if (m->sampler)
+        lxpanel_sampler_unsubscribe(m->sampler);
     g_free(m->color);
     if (m->pixmap)
         cairo_surface_destroy(m->pixmap);
     if (m->stats)
         g_free(m->stats);
+    g_free(m->previous_cores);
     g_free(m);
 
     return;
@@ -226,6 +248,38 @@ monitor_set_foreground_color(MonitorsPlugin *mp, Monitor *m, const gchar *color)
     gdk_rgba_parse(&m->foreground_color, color);
 #else
     gdk_color_parse(color, &m->foreground_color);
+#endif
+    if (m->pixmap)
+        redraw_pixmap(m);
+}
+
+/*
+ * Changes number of values stored for each sample. History cannot be kept
+ * since layout of the buffer changes, so the graph starts from scratch.
+ */
+static void
+monitor_set_n_values(Monitor *m, gint n_values)
+{
+    g_free(m->stats);
+    m->stats = NULL;
+    if (m->pixmap_width > 0)
+        m->stats = g_new0(stats_set, m->pixmap_width * n_values);
+    m->n_values = n_values;
+    m->ring_cursor = 0;
+}
+
+/* Sets source color of cr to foreground color scaled by factor */
+static void
+monitor_set_source_shade(Monitor *m, cairo_t *cr, double factor)
+{
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_set_source_rgb(cr, m->foreground_color.red * factor,
+                         m->foreground_color.green * factor,
+                         m->foreground_color.blue * factor);
+#else
+    cairo_set_source_rgb(cr, m->foreground_color.red * factor / 65535.0,
+                         m->foreground_color.green * factor / 65535.0,
+                         m->foreground_color.blue * factor / 65535.0);
 #endif
 }
 /******************************************************************************
@@ -235,55 +289,78 @@ monitor_set_foreground_color(MonitorsPlugin *mp, Monitor *m, const gchar *color)
 /******************************************************************************
  *                                 CPU monitor                                *
  ******************************************************************************/
-typedef unsigned long long CPUTick;/* Value from /proc/stat                   */
-typedef float CPUSample;	   /* Saved CPU utilization value as 0.0..1.0 */
-
-struct cpu_stat {
-    CPUTick u, n, s, i;		  /* User, nice, system, idle */
-};
-
 static gboolean
-cpu_update(Monitor * c)
+cpu_update(Monitor * c, const LXPanelSample *sample)
 {
-    static struct cpu_stat previous_cpu_stat = { 0, 0, 0, 0 };
+    gboolean per_core;
+    gint n_values, k;
+
+    /* Ensure that /proc/stat was read. */
+    if (!sample->valid)
+        return TRUE;
+
+    /* All cores come from the same reading of /proc/stat as the total, so
+     * per-core mode costs no more than a single read per tick. */
+    per_core = (c->mode != CPU_MODE_TOTAL && sample->n_cores > 0);
+    n_values = per_core ? (gint)sample->n_cores : 1;
+    if (n_values != c->n_values || per_core != (c->previous_cores != NULL))
+    {
+        /* Display mode or number of cores changed, restart the graph from
+         * this sample. */
+        monitor_set_n_values(c, n_values);
+        g_free(c->previous_cores);
+        c->previous_cores = NULL;
+        if (per_core)
+            c->previous_cores = g_memdup(sample->cores,
+                                         n_values * sizeof(LXPanelCpuTicks));
+        c->previous_cpu = sample->cpu;
+        return TRUE;
+    }
 
     if ((c->stats != NULL) && (c->pixmap != NULL))
     {
-        /* Open statistics file and scan out CPU usage. */
-        struct cpu_stat cpu;
-        FILE * stat = fopen("/proc/stat", "r");
-        if (stat == NULL)
-            return TRUE;
-        int fscanf_result = fscanf(stat, "cpu %llu %llu %llu %llu",
-                                    &cpu.u, &cpu.n, &cpu.s, &cpu.i);
-        fclose(stat);
-
-        /* Ensure that fscanf succeeded. */
-        if (fscanf_result == 4)
-        {
-            /* Comcolors delta from previous statistics. */
-            struct cpu_stat cpu_delta;
-            cpu_delta.u = cpu.u - previous_cpu_stat.u;
-            cpu_delta.n = cpu.n - previous_cpu_stat.n;
-            cpu_delta.s = cpu.s - previous_cpu_stat.s;
-            cpu_delta.i = cpu.i - previous_cpu_stat.i;
-
-            /* Copy current to previous. */
-            memcpy(&previous_cpu_stat, &cpu, sizeof(struct cpu_stat));
-
-            /* Comcolors user+nice+system as a fraction of total.
-             * Introduce this sample to ring buffer, increment and wrap ring
-             * buffer cursor. */
-            float cpu_uns = cpu_delta.u + cpu_delta.n + cpu_delta.s;
-            c->stats[c->ring_cursor] = cpu_uns / (cpu_uns + cpu_delta.i);
-            c->ring_cursor += 1;
-            if (c->ring_cursor >= c->pixmap_width)
-                c->ring_cursor = 0;
-
-            /* Redraw with the new sample. */
-            redraw_pixmap(c);
-        }
+        /* Introduce this sample to ring buffer: compute user+nice+system
+         * as a fraction of total since previous sample. */
+        stats_set *column = &c->stats[c->ring_cursor * n_values];
+
+        if (per_core)
+            for (k = 0; k < n_values; k++)
+                column[k] = lxpanel_cpu_ticks_load(&c->previous_cores[k],
+                                                   &sample->cores[k]);
+        else
+            column[0] = lxpanel_cpu_ticks_load(&c->previous_cpu, &sample->cpu);
+
+        /* Draw the new sample. */
+        update_pixmap(c, c->ring_cursor);
+
+        /* Increment and wrap ring buffer cursor. */
+        c->ring_cursor += 1;
+        if (c->ring_cursor >= c->pixmap_width)
+            c->ring_cursor = 0;
     }
+
+    /* Export readings, per-core ones only in per-core mode. */
+    if (lxpanel_metrics_enabled())
+    {
+        char name[16];
+
+        lxpanel_metrics_publish("cpu.load", "%", sample->time,
+                                lxpanel_cpu_ticks_load(&c->previous_cpu, &sample->cpu) * 100);
+        if (per_core)
+            for (k = 0; k < n_values; k++)
+            {
+                g_snprintf(name, sizeof(name), "cpu%d.load", k);
+                lxpanel_metrics_publish(name, "%", sample->time,
+                                        lxpanel_cpu_ticks_load(&c->previous_cores[k],
+                                                               &sample->cores[k]) * 100);
+            }
+    }
+
+    /* Copy current to previous. */
+    c->previous_cpu = sample->cpu;
+    if (per_core)
+        memcpy(c->previous_cores, sample->cores,
+               n_values * sizeof(LXPanelCpuTicks));
     return TRUE;
 }
 
@@ -291,13 +368,24 @@ static void
 cpu_tooltip_update (Monitor *m)
 {
     if (m && m->stats) {
-        gchar *tooltip_text;
+        GString *tooltip_text;
         gint ring_pos = (m->ring_cursor == 0)
             ? m->pixmap_width - 1 : m->ring_cursor - 1;
-        tooltip_text = g_strdup_printf(_("CPU usage: %.2f%%"),
-                m->stats[ring_pos] * 100);
-        gtk_widget_set_tooltip_text(m->da, tooltip_text);
-        g_free(tooltip_text);
+        stats_set *column = &m->stats[ring_pos * m->n_values];
+        float total = 0.0;
+        gint k;
+
+        for (k = 0; k < m->n_values; k++)
+            total += column[k];
+        tooltip_text = g_string_new(NULL);
+        g_string_printf(tooltip_text, _("CPU usage: %.2f%%"),
+                        total * 100 / m->n_values);
+        if (m->n_values > 1)
+            for (k = 0; k < m->n_values; k++)
+                g_string_append_printf(tooltip_text, _("\nCore %d: %.0f%%"),
+                                       k, column[k] * 100);
+        gtk_widget_set_tooltip_text(m->da, tooltip_text->str);
+        g_string_free(tooltip_text, TRUE);
     }
 }
 
@@ -309,61 +397,27 @@ cpu_tooltip_update (Monitor *m)
  *                               RAM Monitor                                  *
  ******************************************************************************/
 static gboolean
-mem_update(Monitor * m)
+mem_update(Monitor * m, const LXPanelSample *sample)
 {
-    ENTER;
-
-    FILE *meminfo;
-    char buf[80];
-    long int mem_total = 0;
-    long int mem_free  = 0;
-    long int mem_buffers = 0;
-    long int mem_cached = 0;
-    long int mem_sreclaimable = 0;
-    unsigned int readmask = 0x10 | 0x8 | 0x4 | 0x2 | 0x1;
+    gulong used;
 
-    if (!m->stats || !m->pixmap)
-        RET(TRUE);
+    ENTER;
 
-    meminfo = fopen("/proc/meminfo", "r");
-    if (!meminfo) {
-        g_warning("monitors: Could not open /proc/meminfo: %d, %s",
-                  errno, strerror(errno));
+    if (!sample->valid) {
+        g_warning("monitors: Could not read %s", sample->path);
         RET(FALSE);
     }
 
-    while (readmask && fgets(buf, sizeof(buf), meminfo)) {
-        if (sscanf(buf, "MemTotal: %ld kB\n", &mem_total) == 1) {
-            readmask ^= 0x1;
-            continue;
-        }
-        if (sscanf(buf, "MemFree: %ld kB\n", &mem_free) == 1) {
-            readmask ^= 0x2;
-            continue;
-        }
-        if (sscanf(buf, "Buffers: %ld kB\n", &mem_buffers) == 1) {
-            readmask ^= 0x4;
-            continue;
-        }
-        if (sscanf(buf, "Cached: %ld kB\n", &mem_cached) == 1) {
-            readmask ^= 0x8;
-            continue;
-        }
-        if (sscanf(buf, "SReclaimable: %ld kB\n", &mem_sreclaimable) == 1) {
-            readmask ^= 0x10;
-            continue;
-        }
-    }
-
-    fclose(meminfo);
+    used = sample->mem_total - sample->mem_buffers - sample->mem_free -
+           sample->mem_cached - sample->mem_sreclaimable;
+    lxpanel_metrics_publish("mem.used", "kB", sample->time, used);
+    lxpanel_metrics_publish("mem.usage", "%", sample->time,
+                            used * 100.0 / sample->mem_total);
 
-    if (readmask) {
-        g_warning("monitors: Couldn't read all values from /proc/meminfo: "
-                  "readmask %x", readmask);
-        RET(FALSE);
-    }
+    if (!m->stats || !m->pixmap)
+        RET(TRUE);
 
-    m->total = mem_total;
+    m->total = sample->mem_total;
 
     /* Adding stats to the buffer:
      * It is debatable if 'mem_buffers' counts as free or not. I'll go with
@@ -375,16 +429,15 @@ mem_update(Monitor * m)
      * 'man free' doesn't specify this)
      * 'mem_cached' definitely counts as 'free' because it is immediately
      * released should any application need it. */
-    m->stats[m->ring_cursor] = (mem_total - mem_buffers - mem_free -
-            mem_cached - mem_sreclaimable) / (float)mem_total;
+    m->stats[m->ring_cursor] = used / (float)sample->mem_total;
+
+    /* Draw the new sample */
+    update_pixmap (m, m->ring_cursor);
 
     m->ring_cursor++;
     if (m->ring_cursor >= m->pixmap_width)
         m->ring_cursor = 0;
 
-    /* Redraw the pixmap, with the new sample */
-    redraw_pixmap (m);
-
     RET(TRUE);
 }
 
@@ -433,7 +486,10 @@ configure_event(GtkWidget* widget, GdkEventConfigure* dummy, gpointer data)
          */
         if (!m->stats || (new_pixmap_width != m->pixmap_width))
         {
-            stats_set *new_stats = g_new0(stats_set, new_pixmap_width);
+            /* Each column holds n_values values, all copying below is done
+             * in columns. */
+            gint n = m->n_values;
+            stats_set *new_stats = g_new0(stats_set, new_pixmap_width * n);
 
             if (!new_stats)
                 return TRUE;
@@ -450,10 +506,10 @@ configure_event(GtkWidget* widget, GdkEventConfigure* dummy, gpointer data)
 
                     memcpy(new_stats,
                            m->stats,
-                           m->ring_cursor * sizeof (stats_set));
-                    memcpy(new_stats + nvalues,
-                           m->stats + m->ring_cursor,
-                           nvalues * sizeof(stats_set));
+                           m->ring_cursor * n * sizeof (stats_set));
+                    memcpy(new_stats + (new_pixmap_width - nvalues) * n,
+                           m->stats + m->ring_cursor * n,
+                           nvalues * n * sizeof(stats_set));
                 }
                 /* New allocation is smaller, but still larger than the ring
                  * buffer cursor */
@@ -464,10 +520,10 @@ configure_event(GtkWidget* widget, GdkEventConfigure* dummy, gpointer data)
                     int nvalues = new_pixmap_width - m->ring_cursor;
                     memcpy(new_stats,
                            m->stats,
-                           m->ring_cursor * sizeof(stats_set));
-                    memcpy(new_stats + m->ring_cursor,
-                           m->stats + m->pixmap_width - nvalues,
-                           nvalues * sizeof(stats_set));
+                           m->ring_cursor * n * sizeof(stats_set));
+                    memcpy(new_stats + m->ring_cursor * n,
+                           m->stats + (m->pixmap_width - nvalues) * n,
+                           nvalues * n * sizeof(stats_set));
                 }
                 /* New allocation is smaller, and also smaller than the ring
                  * buffer cursor.  Discard all oldest samples following the ring
@@ -476,8 +532,9 @@ configure_event(GtkWidget* widget, GdkEventConfigure* dummy, gpointer data)
                 else
                 {
                     memcpy(new_stats,
-                           m->stats + m->ring_cursor - new_pixmap_width,
-                           new_pixmap_width * sizeof(stats_set));
+                           m->stats + (m->ring_cursor - new_pixmap_width) * n,
+                           new_pixmap_width * n * sizeof(stats_set));
+                    m->ring_cursor = 0;
                 }
                 g_free(m->stats);
             }
@@ -519,8 +576,19 @@ draw(GtkWidget * widget, cairo_t * cr, Monitor *m)
 #else
         cairo_set_source_rgb(cr, 0, 0, 0); // FIXME: set the color from style
 #endif
-        cairo_set_source_surface(cr, m->pixmap, BORDER_SIZE, BORDER_SIZE);
-        cairo_paint(cr);
+        /* Columns from the ring cursor to the end of the pixmap are the
+         * oldest ones and go to the left, newer ones follow them. */
+        int split = m->pixmap_width - m->ring_cursor;
+
+        cairo_set_source_surface(cr, m->pixmap,
+                                 BORDER_SIZE - m->ring_cursor, BORDER_SIZE);
+        cairo_rectangle(cr, BORDER_SIZE, BORDER_SIZE, split, m->pixmap_height);
+        cairo_fill(cr);
+        cairo_set_source_surface(cr, m->pixmap,
+                                 BORDER_SIZE + split, BORDER_SIZE);
+        cairo_rectangle(cr, BORDER_SIZE + split, BORDER_SIZE,
+                        m->ring_cursor, m->pixmap_height);
+        cairo_fill(cr);
         check_cairo_status(cr);
 #if !GTK_CHECK_VERSION(3, 0, 0)
         cairo_destroy(cr);
@@ -550,39 +618,88 @@ static gboolean monitors_button_press_event(GtkWidget* widget, GdkEventButton* e
  *                       End of basic events handlers                         *
  ******************************************************************************/
 
+/*
+ * The pixmap is circular like the stats buffer: column x of the pixmap shows
+ * stats of sample x, and the draw handler blits it in two parts so that the
+ * oldest sample, at the ring cursor, appears on the left. Thus a new sample
+ * only needs its own column drawn, not the whole graph.
+ */
 static void
-redraw_pixmap (Monitor *m)
+draw_column (Monitor *m, cairo_t *cr, int x)
 {
-    int i;
-    cairo_t *cr = cairo_create(m->pixmap);
+    int k;
+    int n = m->n_values;
+    stats_set *column = &m->stats[x * n];
 #if !GTK_CHECK_VERSION(3, 0, 0)
     GtkStyle *style = gtk_widget_get_style(m->da);
 #endif
 
-    cairo_set_line_width (cr, 1.0);
-
-    /* Erase pixmap */
+    /* Erase column */
 #if GTK_CHECK_VERSION(3, 0, 0)
     cairo_set_source_rgb(cr, 0, 0, 0); // FIXME: use black color from style
 #else
     gdk_cairo_set_source_color(cr, &style->black);
 #endif
-    cairo_paint(cr);
+    cairo_rectangle(cr, x, 0, 1, m->pixmap_height);
+    cairo_fill(cr);
 
-#if GTK_CHECK_VERSION(3, 0, 0)
-    gdk_cairo_set_source_rgba(cr, &m->foreground_color);
-#else
-    gdk_cairo_set_source_color(cr, &m->foreground_color);
-#endif
-    for (i = 0; i < m->pixmap_width; i++)
+    if (n > 1 && m->mode == CPU_MODE_HEATMAP)
     {
-        unsigned int drawing_cursor = (m->ring_cursor + i) % m->pixmap_width;
+        /* One horizontal band per core, brightness of each pixel is the
+         * load of the core at that moment. */
+        for (k = 0; k < n; k++)
+        {
+            int top = k * m->pixmap_height / n;
+            int bottom = (k + 1) * m->pixmap_height / n;
+
+            if (column[k] <= 0.0)
+                continue;
+            monitor_set_source_shade(m, cr, column[k]);
+            cairo_rectangle(cr, x, top, 1, bottom - top);
+            cairo_fill(cr);
+        }
+    }
+    else if (n > 1)
+    {
+        /* Loads of cores are stacked on each other, each core taking 1/n
+         * of height, alternating shades of the color to tell them apart. */
+        double y = m->pixmap_height;
 
+        for (k = 0; k < n; k++)
+        {
+            double height = column[k] * m->pixmap_height / n;
+
+            if (height <= 0.0)
+                continue;
+            monitor_set_source_shade(m, cr, (k & 1) ? 0.6 : 1.0);
+            cairo_rectangle(cr, x, y - height, 1, height);
+            cairo_fill(cr);
+            y -= height;
+        }
+    }
+    else if (column[0] > 0.0)
+    {
         /* Draw one bar of the graph */
-        cairo_move_to(cr, i + 0.5, m->pixmap_height);
-        cairo_line_to(cr, i + 0.5, (1.0 - m->stats[drawing_cursor]) * m->pixmap_height);
-        cairo_stroke(cr);
+#if GTK_CHECK_VERSION(3, 0, 0)
+        gdk_cairo_set_source_rgba(cr, &m->foreground_color);
+#else
+        gdk_cairo_set_source_color(cr, &m->foreground_color);
+#endif
+        cairo_rectangle(cr, x, (1.0 - column[0]) * m->pixmap_height, 1,
+                        column[0] * m->pixmap_height);
+        cairo_fill(cr);
     }
+}
+
+/* Redraw whole pixmap, after it was resized or the color changed */
+static void
+redraw_pixmap (Monitor *m)
+{
+    int i;
+    cairo_t *cr = cairo_create(m->pixmap);
+
+    for (i = 0; i < m->pixmap_width; i++)
+        draw_column(m, cr, i);
 
     check_cairo_status(cr);
     cairo_destroy(cr);
@@ -590,6 +707,19 @@ redraw_pixmap (Monitor *m)
     gtk_widget_queue_draw(m->da);
 }
 
+/* Draw the column of the newest sample */
+static void
+update_pixmap (Monitor *m, int x)
+{
+    cairo_t *cr = cairo_create(m->pixmap);
+
+    draw_column(m, cr, x);
+
+    check_cairo_status(cr);
+    cairo_destroy(cr);
+    gtk_widget_queue_draw(m->da);
+}
+
 
 static update_func update_functions [N_MONITORS] = {
     [CPU_POSITION] = cpu_update,
@@ -615,38 +745,27 @@ static char *colors[N_MONITORS] = {
     NULL
 };
 
+static LXPanelSampleType sample_types[N_MONITORS] = {
+    [CPU_POSITION] = LXPANEL_SAMPLE_CPU,
+    [MEM_POSITION] = LXPANEL_SAMPLE_MEMORY
+};
+
 /*
- * This function is called every UPDATE_PERIOD seconds. It updates all
- * monitors.
+ * This function is called every UPDATE_PERIOD milliseconds with a new sample
+ * from the shared sampler. It updates the monitor.
  */
-static gboolean
-monitors_update(gpointer data)
+static void
+monitor_update(const LXPanelSample *sample, gpointer data)
 {
-    MonitorsPlugin *mp;
-    int i;
+    Monitor *m = data;
 
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
-    mp = (MonitorsPlugin *) data;
-    if (!mp)
-        RET(FALSE);
-
-    for (i = 0; i < N_MONITORS; i++)
-    {
-        if (mp->monitors[i])
-        {
-            mp->monitors[i]->update(mp->monitors[i]);
-            if (mp->monitors[i]->update_tooltip)
-                mp->monitors[i]->update_tooltip(mp->monitors[i]);
-        }
-    }
-
-    return TRUE;
+    m->update(m, sample);
+    if (m->update_tooltip)
+        m->update_tooltip(m);
 }
 
 static Monitor*
-monitors_add_monitor (GtkWidget *p, MonitorsPlugin *mp, update_func update,
-             tooltip_update_func update_tooltip, gchar *color)
+monitors_add_monitor (GtkWidget *p, MonitorsPlugin *mp, int i, gchar *color)
 {
     ENTER;
 
@@ -654,10 +773,20 @@ monitors_add_monitor (GtkWidget *p, MonitorsPlugin *mp, update_func update,
 
     m = g_new0(Monitor, 1);
     m = monitor_init(mp, m, color);
-    m->update = update;
-    m->update_tooltip = update_tooltip;
+    m->n_values = 1;
+    if (i == CPU_POSITION)
+        m->mode = mp->cpu_mode;
+    m->update = update_functions[i];
+    m->update_tooltip = tooltip_update[i];
     gtk_box_pack_start(GTK_BOX(p), m->da, FALSE, FALSE, 0);
     gtk_widget_show(m->da);
+    /* Take initial reading so the first update has something to compare
+     * with and per-core buffers are sized before the first configure. */
+    if (i == CPU_POSITION)
+        cpu_update(m, lxpanel_sampler_read(LXPANEL_SAMPLE_CPU, NULL, 0));
+    /* Monitors are updated every UPDATE_PERIOD milliseconds */
+    m->sampler = lxpanel_sampler_subscribe(sample_types[i], NULL, UPDATE_PERIOD,
+                                           monitor_update, m);
 
     RET(m);
 }
@@ -691,6 +820,9 @@ monitors_constructor(LXPanel *panel, config_setting_t *settings)
                               &mp->displayed_monitors[CPU_POSITION]);
     config_setting_lookup_int(settings, "DisplayRAM",
                               &mp->displayed_monitors[MEM_POSITION]);
+    config_setting_lookup_int(settings, "CPUMode", &mp->cpu_mode);
+    if (mp->cpu_mode < CPU_MODE_TOTAL || mp->cpu_mode > CPU_MODE_HEATMAP)
+        mp->cpu_mode = CPU_MODE_TOTAL;
     if (config_setting_lookup_string(settings, "Action", &tmp))
         mp->action = g_strdup(tmp);
     if (config_setting_lookup_string(settings, "CPUColor", &tmp))
@@ -706,17 +838,10 @@ monitors_constructor(LXPanel *panel, config_setting_t *settings)
 
         if (mp->displayed_monitors[i])
         {
-            mp->monitors[i] = monitors_add_monitor(p, mp,
-                                                   update_functions[i],
-                                                   tooltip_update[i],
-                                                   colors[i]);
+            mp->monitors[i] = monitors_add_monitor(p, mp, i, colors[i]);
         }
     }
 
-    /* Adding a timer : monitors will be updated every UPDATE_PERIOD
-     * seconds */
-    mp->timer = g_timeout_add_seconds(UPDATE_PERIOD, (GSourceFunc) monitors_update,
-                              (gpointer) mp);
     RET(p);
 }
 
@@ -729,10 +854,7 @@ monitors_destructor(gpointer user_data)
 
     mp = (MonitorsPlugin *) user_data;
 
-    /* Removing timer */
-    g_source_remove(mp->timer);
-
-    /* Freeing all monitors */
+    /* Freeing all monitors, that also cancels their updates */
     for (i = 0; i < N_MONITORS; i++)
     {
         if (mp->monitors[i])
@@ -760,6 +882,9 @@ monitors_config (LXPanel *panel, GtkWidget *p)
         panel, monitors_apply_config, p,
         _("Display CPU usage"), &mp->displayed_monitors[0], CONF_TYPE_BOOL,
         _("CPU color"), &colors[CPU_POSITION], CONF_TYPE_STR,
+        _("Total CPU usage"), &mp->cpu_mode, CONF_TYPE_RBUTTON,
+        _("Stacked usage per core"), &mp->cpu_mode, CONF_TYPE_RBUTTON,
+        _("Heatmap of usage per core"), &mp->cpu_mode, CONF_TYPE_RBUTTON,
         _("Display RAM usage"), &mp->displayed_monitors[1], CONF_TYPE_BOOL,
         _("RAM color"), &colors[MEM_POSITION], CONF_TYPE_STR,
         _("Action when clicked (default: lxtask)"), &mp->action, CONF_TYPE_STR,
@@ -792,10 +917,7 @@ start:
         if (mp->displayed_monitors[i] && !mp->monitors[i])
         {
             /* We've just activated monitor<i> */
-            mp->monitors[i] = monitors_add_monitor(p, mp,
-                                                   update_functions[i],
-                                                   tooltip_update[i],
-                                                   colors[i]);
+            mp->monitors[i] = monitors_add_monitor(p, mp, i, colors[i]);
             /*
              * It is probably best for users if their monitors are always
              * displayed in the same order : the CPU monitor always on the left,
@@ -814,6 +936,19 @@ start:
             monitor_free(mp->monitors[i]);
             mp->monitors[i] = NULL;
         }
+        if (i == CPU_POSITION && mp->monitors[i] &&
+            mp->monitors[i]->mode != mp->cpu_mode)
+        {
+            /* We've changed the CPU display mode, restart the graph if the
+             * new mode needs another buffer layout */
+            Monitor *m = mp->monitors[i];
+
+            m->mode = mp->cpu_mode;
+            if ((m->mode == CPU_MODE_TOTAL) != (m->previous_cores == NULL))
+                cpu_update(m, lxpanel_sampler_read(LXPANEL_SAMPLE_CPU, NULL, 0));
+            if (m->pixmap)
+                redraw_pixmap(m);
+        }
         if (mp->monitors[i] &&
             strncmp(mp->monitors[i]->color, colors[i], COLOR_SIZE) != 0)
         {
@@ -832,6 +967,7 @@ start:
     }
     config_group_set_int(mp->settings, "DisplayCPU", mp->displayed_monitors[CPU_POSITION]);
     config_group_set_int(mp->settings, "DisplayRAM", mp->displayed_monitors[MEM_POSITION]);
+    config_group_set_int(mp->settings, "CPUMode", mp->cpu_mode);
     config_group_set_string(mp->settings, "Action", mp->action);
     config_group_set_string(mp->settings, "CPUColor",
                             mp->monitors[CPU_POSITION] ? colors[CPU_POSITION] : NULL);
@@ -849,7 +985,8 @@ LXPanelPluginInit fm_module_init_lxpanel_gtk = {
     .description = N_("Display monitors (CPU, RAM)"),
     .new_instance = monitors_constructor,
     .config = monitors_config,
-    .button_press_event = monitors_button_press_event
+    .button_press_event = monitors_button_press_event,
+    .non_critical = TRUE
 };
 
 /* vim: set sw=4 sts=4 et : */
@@ -33,6 +33,8 @@
 
 #include <glib/gi18n.h>
 
+#include "metrics.h"
+
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #ifdef HAVE_SYS_SOCKIO_H
@@ -455,7 +457,8 @@ netstatus_iface_poll_iface_statistics (NetstatusIface *iface,
 				       gulong         *in_packets,
 				       gulong         *out_packets,
 				       gulong         *in_bytes,
-				       gulong         *out_bytes)
+				       gulong         *out_bytes,
+				       gint64         *sample_time)
 {
   char *error_message;
 
@@ -463,7 +466,8 @@ netstatus_iface_poll_iface_statistics (NetstatusIface *iface,
 							   in_packets,
 							   out_packets,
 							   in_bytes,
-							   out_bytes);
+							   out_bytes,
+							   sample_time);
   if (error_message)
     {
       netstatus_iface_set_polling_error (iface,
@@ -488,6 +492,7 @@ netstatus_iface_poll_state (NetstatusIface *iface)
   int            fd;
   gulong         in_packets, out_packets;
   gulong         in_bytes, out_bytes;
+  gint64         sample_time;
 
   if (!(fd = netstatus_iface_get_sockfd (iface)))
     return NETSTATUS_STATE_DISCONNECTED;
@@ -513,9 +518,20 @@ netstatus_iface_poll_state (NetstatusIface *iface)
   if (!(if_req.ifr_flags & IFF_UP) || !(if_req.ifr_flags & IFF_RUNNING))
     return NETSTATUS_STATE_DISCONNECTED;
 
-  if (!netstatus_iface_poll_iface_statistics (iface, &in_packets, &out_packets, &in_bytes, &out_bytes))
+  if (!netstatus_iface_poll_iface_statistics (iface, &in_packets, &out_packets, &in_bytes, &out_bytes, &sample_time))
     return NETSTATUS_STATE_IDLE;
 
+  if (lxpanel_metrics_enabled ())
+    {
+      char name[64];
+
+      /* counters, readers derive throughput from consecutive readings */
+      g_snprintf (name, sizeof (name), "net.%s.rx_bytes", iface->priv->name);
+      lxpanel_metrics_publish (name, "B", sample_time, in_bytes);
+      g_snprintf (name, sizeof (name), "net.%s.tx_bytes", iface->priv->name);
+      lxpanel_metrics_publish (name, "B", sample_time, out_bytes);
+    }
+
   dprintf (POLLING, "Packets in: %ld out: %ld. Prev in: %ld out: %ld\n",
 	   in_packets, out_packets,
 	   iface->priv->stats.in_packets, iface->priv->stats.out_packets);
@@ -35,6 +35,8 @@
 #include <glib.h>
 #include <glib/gi18n.h>
 
+#include "sampler.h"
+
 #ifdef __FreeBSD__
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -140,15 +142,27 @@ parse_stats_header (char *buf,
     }
 }
 
-static inline FILE *
-get_proc_net_dev_fh (void)
+/* All interfaces are polled at the same time, so the shared sampler reads
+ * /proc/net/dev once and the rest of polls use that reading. */
+#define PROC_NET_DEV_MAX_AGE 250 /* milliseconds */
+
+/* Copies next line of text into buf, returns NULL at the end of text */
+static const char *
+get_next_line (const char *text,
+	       char       *buf,
+	       gsize       size)
 {
-  static FILE *retval = NULL;
+  const char *end;
+  gsize       len;
 
-  if (retval != NULL)
-    return retval;
+  if (text == NULL || text[0] == '\0')
+    return NULL;
+
+  end = strchr (text, '\n');
+  len = end ? (gsize) (end - text + 1) : strlen (text);
+  g_strlcpy (buf, text, MIN (len + 1, size));
 
-  return retval = fopen ("/proc/net/dev", "r");
+  return text + len;
 }
 
 char *
@@ -156,9 +170,11 @@ netstatus_sysdeps_read_iface_statistics (const char  *iface,
 					 gulong      *in_packets,
 					 gulong      *out_packets,
 					 gulong      *in_bytes,
-					 gulong      *out_bytes)
+					 gulong      *out_bytes,
+					 gint64      *sample_time)
 {
-  FILE *fh;
+  const LXPanelSample *sample;
+  const char *text;
   char  buf [512];
   int   prx_idx, ptx_idx;
   int   brx_idx, btx_idx;
@@ -169,19 +185,24 @@ netstatus_sysdeps_read_iface_statistics (const char  *iface,
   g_return_val_if_fail (out_packets != NULL, NULL);
   g_return_val_if_fail (in_bytes != NULL, NULL);
   g_return_val_if_fail (out_bytes != NULL, NULL);
+  g_return_val_if_fail (sample_time != NULL, NULL);
 
   *in_packets  = -1;
   *out_packets = -1;
   *in_bytes    = -1;
   *out_bytes   = -1;
 
-  fh = get_proc_net_dev_fh ();
-  if (!fh)
+  sample = lxpanel_sampler_read (LXPANEL_SAMPLE_TEXT, "/proc/net/dev",
+				 PROC_NET_DEV_MAX_AGE);
+  if (!sample->valid)
     return g_strdup_printf (_("Cannot open /proc/net/dev: %s"),
-			    g_strerror (errno));
+			    g_strerror (sample->error));
+  /* time of the shared reading, not of this poll */
+  *sample_time = sample->time;
 
-  if (fgets (buf, sizeof (buf), fh) == NULL ||
-      fgets (buf, sizeof (buf), fh) == NULL)
+  text = sample->text;
+  if ((text = get_next_line (text, buf, sizeof (buf))) == NULL ||
+      (text = get_next_line (text, buf, sizeof (buf))) == NULL)
     return g_strdup (_("Could not parse /proc/net/dev. No data."));
 
   parse_stats_header (buf, &prx_idx, &ptx_idx, &brx_idx, &btx_idx);
@@ -189,7 +210,7 @@ netstatus_sysdeps_read_iface_statistics (const char  *iface,
       brx_idx == -1 || btx_idx == -1)
     return g_strdup (_("Could not parse /proc/net/dev. Unknown format."));
 
-  while (fgets (buf, sizeof (buf), fh))
+  while ((text = get_next_line (text, buf, sizeof (buf))) != NULL)
     {
       char *stats;
       char *name;
@@ -227,9 +248,6 @@ netstatus_sysdeps_read_iface_statistics (const char  *iface,
   if ((*in_packets == (gulong) -1 || *out_packets == (gulong) -1 || *in_bytes == (gulong) -1 || *out_bytes == (gulong) -1) && !error_message)
     error_message = g_strdup_printf ("Could not find information on interface '%s' in /proc/net/dev", iface);
 
-  rewind (fh);
-  fflush (fh);
-
   return error_message;
 }
 
@@ -574,7 +592,8 @@ netstatus_sysdeps_read_iface_statistics (const char *iface,
 					 gulong     *in_packets,
 					 gulong     *out_packets,
 					 gulong     *in_bytes,
-					 gulong     *out_bytes)
+					 gulong     *out_bytes,
+					 gint64     *sample_time)
 {
   GError  *error;
   char    *command_line;
@@ -587,11 +606,13 @@ netstatus_sysdeps_read_iface_statistics (const char *iface,
   g_return_val_if_fail (out_packets != NULL, NULL);
   g_return_val_if_fail (in_bytes != NULL, NULL);
   g_return_val_if_fail (out_bytes != NULL, NULL);
+  g_return_val_if_fail (sample_time != NULL, NULL);
 
   *in_packets  = -1;
   *out_packets = -1;
   *in_bytes    = -1;
   *out_bytes   = -1;
+  *sample_time = g_get_monotonic_time ();
 
   error = NULL;
   command_line = g_strdup_printf ("/usr/bin/netstat -n -I %s -b -f inet", iface);
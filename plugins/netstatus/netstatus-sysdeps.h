@@ -33,7 +33,8 @@ char *netstatus_sysdeps_read_iface_statistics       (const char *iface,
 						     gulong     *in_packets,
 						     gulong     *out_packets,
 						     gulong     *in_bytes,
-						     gulong     *out_bytes);
+						     gulong     *out_bytes,
+						     gint64     *sample_time);
 char *netstatus_sysdeps_read_iface_wireless_details (const char *iface,
 						     gboolean   *is_wireless,
 						     int        *signal_strength);
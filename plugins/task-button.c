@@ -51,6 +51,9 @@
 #include "gtk-compat.h"
 
 #include "task-button.h"
+#include "icon-convert.h"
+#include "icon-cache.h"
+#include "task-index.h"
 
 #define ALL_WORKSPACES       -1
 
@@ -61,14 +64,18 @@ static Atom a_NET_WM_STATE_MAXIMIZED_HORZ;
  * Class data
  */
 
+typedef struct _TaskIconJob TaskIconJob;
+
 /* individual task data */
 typedef struct
 {
     Window win;                             /* X window ID */
+    TaskButton * button;        /* button which contains this task */
     gint desktop;                           /* Desktop that contains task, needed to switch to it on Raise */
     gint monitor;                           /* Monitor that the window is on or closest to */
     char * name;                            /* Taskbar label when normal, from WM_NAME or NET_WM_NAME */
     GdkPixbuf * icon;           /* the taskbar icon */
+    TaskIconJob * icon_job;     /* icon which is being prepared in thread */
     GtkWidget * menu_item;      /* if menu_list exists then it's an item in it */
     Atom name_source;                       /* Atom that is the source of taskbar label */
     Atom image_source;                      /* Atom that is the source of taskbar icon */
@@ -238,6 +245,7 @@ static TaskDetails *task_details_for_window(TaskButton *button, Window win)
 
     /* fetch task details */
     details->win = win;
+    details->button = button;
     details->desktop = get_net_wm_desktop(win);
     details->monitor = get_window_monitor(win);
     task_set_names(details, None);
@@ -251,18 +259,41 @@ static TaskDetails *task_details_for_window(TaskButton *button, Window win)
     return details;
 }
 
+static void task_icon_job_cancel(TaskDetails *details);
+
 static void free_task_details(TaskDetails *details)
 {
+    task_icon_job_cancel(details);
     g_free(details->name);
     if (details->icon)
         g_object_unref(details->icon);
     g_slice_free(TaskDetails, details);
 }
 
+/* Window -> TaskDetails index is kept on the parent widget of buttons so
+   the owner of any window can be found without walking all the buttons */
+static inline void task_details_index(GtkWidget *parent, TaskDetails *details)
+{
+    task_index_add(G_OBJECT(parent), details->win, details);
+}
+
+static inline void task_details_unindex(GtkWidget *parent, TaskDetails *details)
+{
+    task_index_remove(G_OBJECT(parent), details->win, details);
+}
+
 static TaskDetails *task_details_lookup(TaskButton *task, Window win)
 {
+    GtkWidget *parent = gtk_widget_get_parent(GTK_WIDGET(task));
+    TaskDetails *details;
     GList *l;
 
+    if (parent)
+    {
+        details = task_index_lookup(G_OBJECT(parent), win);
+        return (details && details->button == task) ? details : NULL;
+    }
+    /* button isn't added to a container yet */
     for (l = task->details; l; l = l->next)
         if (((TaskDetails *)l->data)->win == win)
             return l->data;
@@ -819,6 +850,141 @@ static GdkPixbuf * apply_mask(GdkPixbuf * pixbuf, GdkPixbuf * mask)
     return with_alpha;
 }
 
+/* Test if icon of size w x h is better to scale into required size than
+   the best one found so far: the smallest icon not smaller than required
+   size is the best, otherwise the largest one. */
+static gboolean icon_size_is_better(gulong w, gulong h, gulong best_w,
+                                    gulong best_h, guint required_width,
+                                    guint required_height)
+{
+    gboolean fits = (w >= required_width && h >= required_height);
+    gboolean best_fits = (best_w >= required_width && best_h >= required_height);
+
+    if (best_w == 0 || best_h == 0)
+        return TRUE;
+    if (fits != best_fits)
+        return fits;
+    if (fits)
+        return (w * h < best_w * best_h);
+    return (w * h > best_w * best_h);
+}
+
+/* Read _NET_WM_ICON in two phases: first only width and height of each
+   image in the property, then pixels of the single image which fits the
+   required size best, instead of copying all the images from X server.
+   Returns data that should be freed with XFree(), or NULL. */
+static gulong * get_net_wm_icon(Display *xdisplay, Window task_win,
+                                guint required_width, guint required_height,
+                                gulong *icon_w, gulong *icon_h)
+{
+    Atom type = None;
+    int format;
+    gulong nitems;
+    gulong bytes_after;
+    gulong * data;
+    gulong offset = 0, total = 0;
+    gulong best_offset = 0, best_w = 0, best_h = 0;
+    gulong transferred = 0;
+
+    do
+    {
+        gulong w, h, size;
+
+        data = NULL;
+        if (XGetWindowProperty(xdisplay, task_win, a_NET_WM_ICON, offset, 2,
+                               False, XA_CARDINAL, &type, &format, &nitems,
+                               &bytes_after, (void *) &data) != Success)
+            return NULL;
+        if ((type != XA_CARDINAL) || (nitems < 2))
+        {
+            if (data != NULL)
+                XFree(data);
+            break;
+        }
+        w = data[0];
+        h = data[1];
+        XFree(data);
+        transferred += nitems * 4;
+        /* bytes_after is in bytes, offsets are in 32-bit units */
+        total = offset + nitems + bytes_after / 4;
+        size = w * h;
+
+        /* Bounds check the icon. Also check for invalid width and height,
+           see http://bugs.debian.org/cgi-bin/bugreport.cgi?bug=801319 */
+        if (size == 0 || w > 1024 || h > 1024 || offset + 2 + size > total)
+            break;
+
+        if (icon_size_is_better(w, h, best_w, best_h, required_width, required_height))
+        {
+            best_offset = offset + 2;
+            best_w = w;
+            best_h = h;
+        }
+        /* Rare special case: the desired size is the same as icon size. */
+        if ((required_width == w) && (required_height == h))
+            break;
+        offset += 2 + size;
+    }
+    while (offset + 2 < total);
+
+    if (best_w == 0)
+        return NULL;
+
+    /* Fetch pixels of the selected icon only. */
+    data = NULL;
+    if (XGetWindowProperty(xdisplay, task_win, a_NET_WM_ICON, best_offset,
+                           best_w * best_h, False, XA_CARDINAL, &type, &format,
+                           &nitems, &bytes_after, (void *) &data) != Success)
+        return NULL;
+    if ((type != XA_CARDINAL) || (nitems != best_w * best_h))
+    {
+        if (data != NULL)
+            XFree(data);
+        return NULL;
+    }
+    transferred += nitems * 4;
+    g_debug("task-button: _NET_WM_ICON %lux%lu of window 0x%lx: %lu of %lu bytes transferred",
+            best_w, best_h, task_win, transferred, total * 4);
+    *icon_w = best_w;
+    *icon_h = best_h;
+    return data;
+}
+
+/* Convert image from _NET_WM_ICON into pixbuf, data are not freed. */
+static GdkPixbuf * pixbuf_from_net_wm_icon(const gulong * data, gulong w, gulong h)
+{
+    /* Allocate enough space for the pixel data. */
+    gulong len = w * h;
+    guchar * pixdata = g_new(guchar, len * 4);
+
+    /* Convert the pixel data. */
+    icon_argb_to_rgba(data, pixdata, len);
+
+    /* Initialize a pixmap with the pixel data. */
+    return gdk_pixbuf_new_from_data(pixdata,
+                                    GDK_COLORSPACE_RGB,
+                                    TRUE, 8,    /* has_alpha, bits_per_sample */
+                                    w, h, w * 4,
+                                    (GdkPixbufDestroyNotify) g_free,
+                                    NULL);
+}
+
+/* Scale icon to the required size, consumes the reference on pixmap. */
+static GdkPixbuf * scale_wm_icon(GdkPixbuf * pixmap, guint required_width,
+                                 guint required_height, gboolean upscale)
+{
+    GdkPixbuf * ret;
+
+    if (!upscale
+        && ((guint)gdk_pixbuf_get_width(pixmap) <= required_width
+            || (guint)gdk_pixbuf_get_height(pixmap) <= required_height))
+        return pixmap;
+    ret = gdk_pixbuf_scale_simple(pixmap, required_width, required_height,
+                                  GDK_INTERP_BILINEAR);
+    g_object_unref(pixmap);
+    return ret;
+}
+
 /* Get an icon from the window manager for a task, and scale it to a specified size. */
 static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
                                guint required_height, Atom source,
@@ -830,6 +996,8 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
     int result = -1;
     Display *xdisplay = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
     GdkScreen *screen = gtk_widget_get_screen(GTK_WIDGET(tb));
+    gboolean upscale = !tb->flags.disable_taskbar_upscale;
+    guint64 icon_hash = 0;
 
     if ((source == None) || (source == a_NET_WM_ICON))
     {
@@ -846,106 +1014,36 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
          */
 
         /* Get the window property _NET_WM_ICON, if possible. */
-        Atom type = None;
-        int format;
-        gulong nitems;
-        gulong bytes_after;
-        gulong * data = NULL;
-        result = XGetWindowProperty(
-            xdisplay,
-            task_win,
-            a_NET_WM_ICON,
-            0, G_MAXLONG,
-            False, XA_CARDINAL,
-            &type, &format, &nitems, &bytes_after, (void *) &data);
-
-        /* Inspect the result to see if it is usable.  If not, and we got data, free it. */
-        if ((type != XA_CARDINAL) || (nitems <= 0))
-        {
-            if (data != NULL)
-                XFree(data);
-            result = -1;
-        }
-
-        /* If the result is usable, extract the icon from it. */
-        if (result == Success)
+        gulong max_w = 0;
+        gulong max_h = 0;
+        gulong * max_icon = get_net_wm_icon(xdisplay, task_win, required_width,
+                                            required_height, &max_w, &max_h);
+
+        /* Windows of the same application usually have the same icon,
+         * reuse already scaled one if possible. */
+        if (max_icon != NULL)
         {
-            /* Get the largest icon available, unless there is one that is the desired size. */
-            /* FIXME: should we try to find an icon whose size is closest to
-             * required_width and required_height to reduce unnecessary resizing? */
-            gulong * pdata = data;
-            gulong * pdata_end = data + nitems;
-            gulong * max_icon = NULL;
-            gulong max_w = 0;
-            gulong max_h = 0;
-            while ((pdata + 2) < pdata_end)
+            icon_hash = icon_cache_hash(max_icon, max_w, max_h);
+            pixmap = icon_cache_lookup(icon_hash, required_width,
+                                       required_height, upscale);
+            if (pixmap != NULL)
             {
-                /* Extract the width and height. */
-                guint w = pdata[0];
-                guint h = pdata[1];
-                gulong size = w * h;
-                pdata += 2;
-
-                /* Bounds check the icon. Also check for invalid width and height,
-                   see http://bugs.debian.org/cgi-bin/bugreport.cgi?bug=801319 */
-                if (size == 0 || w > 1024 || h > 1024 || pdata + size > pdata_end)
-                    break;
-
-                /* Rare special case: the desired size is the same as icon size. */
-                if ((required_width == w) && (required_height == h))
-                {
-                    max_icon = pdata;
-                    max_w = w;
-                    max_h = h;
-                    break;
-                }
-
-                /* If the icon is the largest so far, capture it. */
-                if ((w > max_w) && (h > max_h))
-                {
-                    max_icon = pdata;
-                    max_w = w;
-                    max_h = h;
-                }
-                pdata += size;
+                XFree(max_icon);
+                *current_source = a_NET_WM_ICON;
+                return pixmap;
             }
+        }
 
-            /* If an icon was extracted, convert it to a pixbuf.
-             * Its size is max_w and max_h. */
-            if (max_icon != NULL)
-            {
-                /* Allocate enough space for the pixel data. */
-                gulong len = max_w * max_h;
-                guchar * pixdata = g_new(guchar, len * 4);
-
-                /* Loop to convert the pixel data. */
-                guchar * p = pixdata;
-                gulong i;
-                for (i = 0; i < len; p += 4, i += 1)
-                {
-                    guint argb = max_icon[i];
-                    guint rgba = (argb << 8) | (argb >> 24);
-                    p[0] = rgba >> 24;
-                    p[1] = (rgba >> 16) & 0xff;
-                    p[2] = (rgba >> 8) & 0xff;
-                    p[3] = rgba & 0xff;
-                }
-
-                /* Initialize a pixmap with the pixel data. */
-                pixmap = gdk_pixbuf_new_from_data(
-                    pixdata,
-                    GDK_COLORSPACE_RGB,
-                    TRUE, 8,    /* has_alpha, bits_per_sample */
-                    max_w, max_h, max_w * 4,
-                    (GdkPixbufDestroyNotify) g_free,
-                    NULL);
-                possible_source = a_NET_WM_ICON;
-            }
-            else
-                result = -1;
+        /* If an icon was extracted, convert it to a pixbuf.
+         * Its size is max_w and max_h. */
+        if (max_icon != NULL)
+        {
+            pixmap = pixbuf_from_net_wm_icon(max_icon, max_w, max_h);
+            possible_source = a_NET_WM_ICON;
+            result = Success;
 
             /* Free the X property data. */
-            XFree(data);
+            XFree(max_icon);
         }
     }
 
@@ -1067,16 +1165,10 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
         GdkPixbuf * ret;
 
         *current_source = possible_source;
-        if (tb->flags.disable_taskbar_upscale)
-        {
-            guint w = gdk_pixbuf_get_width (pixmap);
-            guint h = gdk_pixbuf_get_height (pixmap);
-            if (w <= required_width || h <= required_height)
-                return pixmap;
-        }
-        ret = gdk_pixbuf_scale_simple(pixmap, required_width, required_height,
-                                      GDK_INTERP_BILINEAR);
-        g_object_unref(pixmap);
+        ret = scale_wm_icon(pixmap, required_width, required_height, upscale);
+        if (ret != NULL && possible_source == a_NET_WM_ICON)
+            icon_cache_insert(icon_hash, required_width, required_height,
+                              upscale, ret);
         return ret;
     }
 }
@@ -1092,6 +1184,8 @@ static void _task_update_icon(TaskButton *task, TaskDetails *details, Atom sourc
     /* Get the icon from the window's hints. */
     if (details != NULL && pixbuf == NULL)
     {
+        /* result of background loader would be outdated now */
+        task_icon_job_cancel(details);
         pixbuf = get_wm_icon(details->win, task->icon_size, task->icon_size,
                              source, &details->image_source, task);
         if (pixbuf)
@@ -1099,7 +1193,7 @@ static void _task_update_icon(TaskButton *task, TaskDetails *details, Atom sourc
             /* replace old cached image */
             if (details->icon)
                 g_object_unref(details->icon);
-            details->icon = g_object_ref_sink(pixbuf);
+            details->icon = pixbuf;
         }
         else
             /* use cached icon if available */
@@ -1127,6 +1221,140 @@ static void _task_update_icon(TaskButton *task, TaskDetails *details, Atom sourc
         gtk_image_set_from_pixbuf(GTK_IMAGE(task->image), pixbuf);
 }
 
+/* Background loader for _NET_WM_ICON: the property is read on the main
+   thread but conversion and scaling are done in a thread pool, then the
+   result is passed back to main thread. Job is cancelled if the window
+   is gone or the icon was updated meanwhile. */
+struct _TaskIconJob
+{
+    TaskDetails *details;       /* NULL if job was cancelled */
+    gint cancelled;             /* set atomically when details is reset */
+    gulong *data;               /* _NET_WM_ICON image, free with XFree() */
+    gulong width, height;       /* size of image */
+    guint required_width, required_height;
+    gboolean upscale;
+    guint64 hash;               /* icon_cache_hash() of image */
+    GdkPixbuf *pixbuf;          /* the result */
+};
+
+static GThreadPool *task_icon_pool = NULL;
+
+static void task_icon_job_free(TaskIconJob *job)
+{
+    if (job->data)
+        XFree(job->data);
+    if (job->pixbuf)
+        g_object_unref(job->pixbuf);
+    g_slice_free(TaskIconJob, job);
+}
+
+static void task_icon_job_cancel(TaskDetails *details)
+{
+    if (details->icon_job == NULL)
+        return;
+    /* job will be freed when it returns to main thread */
+    details->icon_job->details = NULL;
+    g_atomic_int_set(&details->icon_job->cancelled, 1);
+    details->icon_job = NULL;
+}
+
+static gboolean task_icon_job_done(gpointer user_data)
+{
+    TaskIconJob *job = user_data;
+    TaskDetails *details = job->details;
+    TaskButton *task;
+
+    if (details == NULL || job->pixbuf == NULL)
+    {
+        if (details != NULL) /* failed, let sync loader try other sources */
+        {
+            details->icon_job = NULL;
+            _task_update_icon(details->button, details, None);
+        }
+        task_icon_job_free(job);
+        return FALSE;
+    }
+    details->icon_job = NULL;
+    task = details->button;
+    icon_cache_insert(job->hash, job->required_width, job->required_height,
+                      job->upscale, job->pixbuf);
+    if (job->required_width != task->icon_size
+        || job->upscale != !task->flags.disable_taskbar_upscale)
+    {
+        /* button was updated meanwhile, load it again */
+        task_update_icon(task, details, None);
+        task_icon_job_free(job);
+        return FALSE;
+    }
+    if (details->icon)
+        g_object_unref(details->icon);
+    details->icon = job->pixbuf;
+    details->image_source = a_NET_WM_ICON;
+    job->pixbuf = NULL;
+    if (task->last_focused == NULL || task->last_focused == details)
+        gtk_image_set_from_pixbuf(GTK_IMAGE(task->image), details->icon);
+    task_icon_job_free(job);
+    return FALSE;
+}
+
+static void task_icon_job_run(gpointer data, gpointer user_data)
+{
+    TaskIconJob *job = data;
+
+    if (!g_atomic_int_get(&job->cancelled))
+        job->pixbuf = scale_wm_icon(pixbuf_from_net_wm_icon(job->data, job->width,
+                                                            job->height),
+                                    job->required_width, job->required_height,
+                                    job->upscale);
+    gdk_threads_add_idle(task_icon_job_done, job);
+}
+
+/* Starts background loading of _NET_WM_ICON, returns FALSE if the window
+   has no such property */
+static gboolean task_icon_job_start(TaskButton *task, TaskDetails *details)
+{
+    Display *xdisplay = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+    TaskIconJob *job;
+    GdkPixbuf *pixbuf;
+    gulong *data, w = 0, h = 0;
+    guint64 hash;
+    gboolean upscale = !task->flags.disable_taskbar_upscale;
+
+    /* result of previous job would be outdated now */
+    task_icon_job_cancel(details);
+    data = get_net_wm_icon(xdisplay, details->win, task->icon_size,
+                           task->icon_size, &w, &h);
+    if (data == NULL)
+        return FALSE;
+    hash = icon_cache_hash(data, w, h);
+    pixbuf = icon_cache_lookup(hash, task->icon_size, task->icon_size, upscale);
+    if (pixbuf != NULL) /* nothing to do in thread */
+    {
+        XFree(data);
+        if (details->icon)
+            g_object_unref(details->icon);
+        details->icon = pixbuf;
+        details->image_source = a_NET_WM_ICON;
+        if (task->last_focused == NULL || task->last_focused == details)
+            gtk_image_set_from_pixbuf(GTK_IMAGE(task->image), pixbuf);
+        return TRUE;
+    }
+    if (task_icon_pool == NULL)
+        task_icon_pool = g_thread_pool_new(task_icon_job_run, NULL, 2, FALSE, NULL);
+    job = g_slice_new0(TaskIconJob);
+    job->details = details;
+    job->data = data;
+    job->width = w;
+    job->height = h;
+    job->required_width = task->icon_size;
+    job->required_height = task->icon_size;
+    job->upscale = upscale;
+    job->hash = hash;
+    details->icon_job = job;
+    g_thread_pool_push(task_icon_pool, job, NULL);
+    return TRUE;
+}
+
 static gboolean task_update_icon_idle(gpointer user_data)
 {
     TaskButton *task;
@@ -1140,7 +1368,8 @@ static gboolean task_update_icon_idle(gpointer user_data)
     for (l = task->details; l; l = l->next)
     {
         details = l->data;
-        if (details->icon == NULL)
+        if (details->icon == NULL && details->icon_job == NULL
+            && !task_icon_job_start(task, details))
             _task_update_icon(task, details, None);
     }
     return FALSE;
@@ -1148,7 +1377,18 @@ static gboolean task_update_icon_idle(gpointer user_data)
 
 static void task_update_icon(TaskButton *task, TaskDetails *details, Atom source)
 {
-    if (source != None || (details && details->icon))
+    /* _NET_WM_ICON changes, resizes and focus changes of a window that
+       already has an icon: the shown icon stays until the new one is made
+       in thread; other icon sources are still loaded synchronously */
+    if (details && (source == a_NET_WM_ICON || (source == None && details->icon)))
+    {
+        if (details->icon
+            && (task->last_focused == NULL || task->last_focused == details))
+            gtk_image_set_from_pixbuf(GTK_IMAGE(task->image), details->icon);
+        if (!task_icon_job_start(task, details))
+            _task_update_icon(task, details, source);
+    }
+    else if (source != None || (details && details->icon))
         _task_update_icon(task, details, source);
     else if (task->idle_loader == 0)
         task->idle_loader = gdk_threads_add_timeout_full(G_PRIORITY_LOW, 20,
@@ -1445,6 +1685,23 @@ static gboolean task_button_scroll_event(GtkWidget *widget, GdkEventScroll *even
     return TRUE;
 }
 
+/* keep windows index on the parent widget up to date */
+static void task_button_parent_set(GtkWidget *widget, GtkWidget *previous_parent)
+{
+    TaskButton *self = PANEL_TASK_BUTTON(widget);
+    GtkWidget *parent = gtk_widget_get_parent(widget);
+    GList *l;
+
+    if (previous_parent)
+        for (l = self->details; l; l = l->next)
+            task_details_unindex(previous_parent, l->data);
+    if (parent)
+        for (l = self->details; l; l = l->next)
+            task_details_index(parent, l->data);
+    if (GTK_WIDGET_CLASS(task_button_parent_class)->parent_set)
+        GTK_WIDGET_CLASS(task_button_parent_class)->parent_set(widget, previous_parent);
+}
+
 static void task_button_size_allocate(GtkWidget *widget, GtkAllocation *alloc)
 {
     TaskButton *tb = PANEL_TASK_BUTTON(widget);
@@ -1471,6 +1728,7 @@ static void task_button_class_init(TaskButtonClass *klass)
     widget_class->leave_notify_event = task_button_leave_notify_event;
     widget_class->scroll_event = task_button_scroll_event;
     widget_class->size_allocate = task_button_size_allocate;
+    widget_class->parent_set = task_button_parent_set;
 
     /**
      * Signal TaskButton::menu-built is emitted when GtkMenu is built
@@ -1557,14 +1815,45 @@ TaskButton *task_button_new(Window win, gint desk, gint desks, LXPanel *panel,
 
 gboolean task_button_has_window(TaskButton *button, Window win)
 {
-    GList *l;
-
     g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button), FALSE);
 
-    for (l = button->details; l; l = l->next)
-        if (((TaskDetails *)l->data)->win == win)
-            return TRUE;
-    return FALSE;
+    return (task_details_lookup(button, win) != NULL);
+}
+
+/* removes details of window which is gone from client list */
+static void task_button_delete_details_link(TaskButton *button, GList *l)
+{
+    GtkWidget *parent = gtk_widget_get_parent(GTK_WIDGET(button));
+    TaskDetails *details = l->data;
+
+    button->details = g_list_delete_link(button->details, l);
+    if (parent)
+        task_details_unindex(parent, details);
+    free_task_details(details);
+    if (button->last_focused == details)
+        button->last_focused = NULL;
+}
+
+/* updates button after some windows were deleted from it */
+static void task_button_windows_deleted(TaskButton *button)
+{
+    GList *l;
+
+    if (button->details == NULL) /* all windows were deleted */
+    {
+        GList *menu_list = gtk_menu_get_for_attach_widget(GTK_WIDGET(button));
+        menu_list = g_list_copy(menu_list);
+        for (l = menu_list; l; l = l->next)
+        {
+            GtkMenu *menu = GTK_MENU(l->data);
+            gtk_menu_detach(menu);
+        }
+        g_list_free(menu_list);
+        gtk_widget_destroy(GTK_WIDGET(button));
+    }
+    else if (task_update_visibility(button))
+        task_redraw_label(button);
+    // FIXME: test if need to update menu
 }
 
 /* removes windows from button, that are missing in list */
@@ -1586,29 +1875,28 @@ void task_button_update_windows_list(TaskButton *button, Window *list, gint n)
                 break;
         if (i >= n) /* not found, remove details now */
         {
-            button->details = g_list_delete_link(button->details, l);
-            free_task_details(details);
-            if (button->last_focused == details)
-                button->last_focused = NULL;
+            task_button_delete_details_link(button, l);
             has_removed = TRUE;
         }
         l = next; /* go next details */
     }
-    if (button->details == NULL) /* all windows were deleted */
-    {
-        GList *menu_list = gtk_menu_get_for_attach_widget(GTK_WIDGET(button));
-        menu_list = g_list_copy(menu_list);
-        for (l = menu_list; l; l = l->next)
-        {
-            GtkMenu *menu = GTK_MENU(l->data);
-            gtk_menu_detach(menu);
-        }
-        g_list_free(menu_list);
-        gtk_widget_destroy(GTK_WIDGET(button));
-    }
-    else if (has_removed && task_update_visibility(button))
-        task_redraw_label(button);
-    // FIXME: test if need to update menu
+    if (has_removed || button->details == NULL)
+        task_button_windows_deleted(button);
+}
+
+/* removes window from button, which was deleted from client list */
+gboolean task_button_window_deleted(TaskButton *button, Window win)
+{
+    TaskDetails *details;
+
+    g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button), FALSE);
+
+    details = task_details_lookup(button, win);
+    if (details == NULL)
+        return FALSE;
+    task_button_delete_details_link(button, g_list_find(button->details, details));
+    task_button_windows_deleted(button);
+    return TRUE;
 }
 
 /* returns TRUE if found and updated */
@@ -1917,6 +2205,8 @@ gboolean task_button_add_window(TaskButton *button, Window win, const char *cl)
     /* fetch task details */
     details = task_details_for_window(button, win);
     button->details = g_list_append(button->details, details);
+    if (gtk_widget_get_parent(GTK_WIDGET(button)))
+        task_details_index(gtk_widget_get_parent(GTK_WIDGET(button)), details);
     /* redraw label on the button if need */
     if (details->visible)
     {
@@ -1952,6 +2242,8 @@ gboolean task_button_drop_window(TaskButton *button, Window win, gboolean leave_
     }
     details = l->data;
     button->details = g_list_delete_link(button->details, l);
+    if (gtk_widget_get_parent(GTK_WIDGET(button)))
+        task_details_unindex(gtk_widget_get_parent(GTK_WIDGET(button)), details);
     was_last_focused = (button->last_focused == details);
     if (was_last_focused)
         button->last_focused = NULL;
@@ -1974,7 +2266,7 @@ gboolean task_button_drop_window(TaskButton *button, Window win, gboolean leave_
 TaskButton *task_button_split(TaskButton *button)
 {
     TaskButton *sibling;
-    GList *llast;
+    GList *llast, *l;
 
     g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button), NULL);
 
@@ -1990,6 +2282,9 @@ TaskButton *task_button_split(TaskButton *button)
     llast = g_list_last(button->details);
     sibling->details = g_list_remove_link(button->details, llast);
     button->details = llast;
+    /* index on parent will be updated when sibling is added there */
+    for (l = sibling->details; l; l = l->next)
+        ((TaskDetails *)l->data)->button = sibling;
     if (button->last_focused != llast->data)
     {
         /* focused item migrated to sibling */
@@ -2022,11 +2317,15 @@ TaskButton *task_button_split(TaskButton *button)
 /* merges buttons if they are the same class */
 gboolean task_button_merge(TaskButton *button, TaskButton *sibling)
 {
+    GList *l;
+
     g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button) && PANEL_IS_TASK_BUTTON(sibling), FALSE);
 
     if (g_strcmp0(button->res_class, sibling->res_class) != 0)
         return FALSE;
     /* move data lists from sibling appending to button */
+    for (l = sibling->details; l; l = l->next)
+        ((TaskDetails *)l->data)->button = button;
     button->details = g_list_concat(button->details, sibling->details);
     sibling->details = NULL;
     /* update visibility */
@@ -2053,6 +2352,14 @@ void task_button_reset_menu(GtkWidget *parent)
     g_object_set_data(G_OBJECT(parent), "task-button-current", NULL);
 }
 
+/* returns button which contains the window, should be called on button parent widget */
+TaskButton *task_button_find_window(GtkWidget *parent, Window win)
+{
+    TaskDetails *details = task_index_lookup(G_OBJECT(parent), win);
+
+    return details ? details->button : NULL;
+}
+
 /* request for a minimized window to raise */
 void task_button_raise_window(TaskButton *button, guint32 time)
 {
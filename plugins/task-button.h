@@ -68,6 +68,8 @@ TaskButton *task_button_new(Window win, gint desk, gint desks, LXPanel *panel,
 gboolean task_button_has_window(TaskButton *button, Window win);
 /* removes windows from button, that are missing in list */
 void task_button_update_windows_list(TaskButton *button, Window *list, gint n);
+/* removes window that is missing in client list, returns TRUE if found */
+gboolean task_button_window_deleted(TaskButton *button, Window win);
 /* returns TRUE if found and updated */
 gboolean task_button_window_xprop_changed(TaskButton *button, Window win, Atom atom);
 gboolean task_button_window_focus_changed(TaskButton *button, Window *win);
@@ -85,6 +87,8 @@ TaskButton *task_button_split(TaskButton *button);
 gboolean task_button_merge(TaskButton *button, TaskButton *sibling);
 /* single-instance-menu management, should be called on button parent widget */
 void task_button_reset_menu(GtkWidget *parent);
+/* returns button which contains the window, should be called on button parent widget */
+TaskButton *task_button_find_window(GtkWidget *parent, Window win);
 /* request for a minimized window to raise */
 void task_button_raise_window(TaskButton *button, guint32 time);
 
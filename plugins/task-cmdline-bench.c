@@ -0,0 +1,168 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Resolves executables of running processes as a storm of new windows
+   would do, with the pid cache and with the reads done before the cache.
+   Reports time and number of read() calls per lookup, the latter taken
+   from /proc/self/io. Each file read costs also an open() and a close(),
+   and g_file_get_contents() which was used before does fstat() as well.
+   Every cached lookup does one fstatat() to check the pid wasn't reused.
+
+   Usage: task-cmdline-bench [lookups] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "task-cmdline.h"
+
+#define MAX_PIDS 64
+
+/* task_get_cmdline() as it was before the cache */
+static char *legacy_lookup(GKeyFile *special_cases, GPid pid)
+{
+    char proc_path[64];
+    gchar *cmdline = NULL;
+    gchar *p_char = NULL;
+
+    snprintf(proc_path, sizeof(proc_path),
+             G_DIR_SEPARATOR_S "proc" G_DIR_SEPARATOR_S "%lu" G_DIR_SEPARATOR_S "cmdline",
+             (gulong)pid);
+    g_file_get_contents(proc_path, &cmdline, NULL, NULL);
+    if (cmdline)
+    {
+        p_char = strchr(cmdline, '\n');
+        if(p_char != NULL) *p_char = '\0';
+        p_char = strrchr(cmdline, G_DIR_SEPARATOR);
+        if (p_char != NULL) p_char++;
+        else p_char = cmdline;
+        if(strcmp(p_char, "python") == 0)
+        {
+            snprintf(proc_path, sizeof(proc_path),
+                     G_DIR_SEPARATOR_S "proc" G_DIR_SEPARATOR_S "%lu" G_DIR_SEPARATOR_S "comm",
+                     (gulong)pid);
+            g_free(cmdline);
+            cmdline = NULL;
+            g_file_get_contents(proc_path, &cmdline, NULL, NULL);
+            if (cmdline)
+            {
+                p_char = strchr(cmdline, '\n');
+                if(p_char != NULL) *p_char = '\0';
+            }
+        }
+        else
+        {
+            p_char = g_key_file_get_string(special_cases,
+                                           "special_cases", p_char, NULL);
+            if (p_char != NULL) /* found this key */
+            {
+                g_free(cmdline);
+                cmdline = p_char;
+            }
+        }
+    }
+    return cmdline;
+}
+
+/* returns number of read() calls done by this process so far */
+static guint64 read_calls(void)
+{
+    char *io = NULL, *p;
+    guint64 n = 0;
+
+    if (g_file_get_contents("/proc/self/io", &io, NULL, NULL) &&
+        (p = strstr(io, "syscr:")) != NULL)
+        n = g_ascii_strtoull(p + 6, NULL, 10);
+    g_free(io);
+    return n;
+}
+
+static guint collect_pids(GPid *pids)
+{
+    GDir *dir = g_dir_open("/proc", 0, NULL);
+    const char *name;
+    guint n = 0;
+
+    while (dir && n < MAX_PIDS && (name = g_dir_read_name(dir)) != NULL)
+        if (g_ascii_isdigit(name[0]))
+            pids[n++] = atoi(name);
+    if (dir)
+        g_dir_close(dir);
+    return n;
+}
+
+static void report(const char *what, guint lookups, gint64 time, guint64 reads)
+{
+    printf("  %-12s %8.2f us/lookup %6.2f read()/lookup\n", what,
+           (double)time / lookups, (double)reads / lookups);
+}
+
+int main(int argc, char **argv)
+{
+    guint lookups = argc > 1 ? atoi(argv[1]) : 20000;
+    GKeyFile *special_cases = g_key_file_new();
+    TaskCmdlineCache *cache = NULL;
+    GPid pids[MAX_PIDS];
+    guint n_pids, i;
+    guint64 reads;
+    gint64 time;
+
+    n_pids = collect_pids(pids);
+    if (lookups == 0 || n_pids == 0)
+    {
+        fprintf(stderr, "usage: %s [lookups]\n", argv[0]);
+        return 2;
+    }
+    g_key_file_set_value(special_cases, "special_cases", "soffice.bin", "libreoffice");
+    printf("%u lookups over %u processes\n", lookups, n_pids);
+
+    reads = read_calls();
+    time = g_get_monotonic_time();
+    for (i = 0; i < lookups; i++)
+        g_free(legacy_lookup(special_cases, pids[i % n_pids]));
+    time = g_get_monotonic_time() - time;
+    report("no cache:", lookups, time, read_calls() - reads - 1);
+
+    /* each process is seen for the first time */
+    reads = read_calls();
+    time = g_get_monotonic_time();
+    for (i = 0; i < lookups; i++)
+    {
+        if (i % n_pids == 0)
+            cache = task_cmdline_cache_new(special_cases);
+        g_free(task_cmdline_cache_lookup(cache, pids[i % n_pids]));
+        if (i % n_pids == n_pids - 1 || i == lookups - 1)
+            task_cmdline_cache_free(cache);
+    }
+    time = g_get_monotonic_time() - time;
+    report("cache miss:", lookups, time, read_calls() - reads - 1);
+
+    cache = task_cmdline_cache_new(special_cases);
+    for (i = 0; i < n_pids; i++)
+        g_free(task_cmdline_cache_lookup(cache, pids[i]));
+    reads = read_calls();
+    time = g_get_monotonic_time();
+    for (i = 0; i < lookups; i++)
+        g_free(task_cmdline_cache_lookup(cache, pids[i % n_pids]));
+    time = g_get_monotonic_time() - time;
+    report("cache hit:", lookups, time, read_calls() - reads - 1);
+    task_cmdline_cache_free(cache);
+
+    g_key_file_free(special_cases);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "task-cmdline.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* Resolved executables are cached by pid. The /proc/<pid> inode is made
+   anew for a process reusing the pid, so its change time is kept to detect
+   that. A single fstatat() is much cheaper than reading /proc/<pid>/stat
+   for the start time; a dropped and remade inode just misses the cache. */
+typedef struct {
+    gint64 ctime;               /* of /proc/<pid>, in nanoseconds */
+    char *cmdline;              /* resolved executable, may be NULL */
+} TaskCmdline;
+
+#define CMDLINE_CACHE_SIZE 128
+
+struct _TaskCmdlineCache {
+    int proc_fd;                /* /proc directory, for openat() */
+    GHashTable *cache;          /* pid -> TaskCmdline */
+    GKeyFile *special_cases;
+};
+
+static void task_cmdline_free(TaskCmdline *tc)
+{
+    g_free(tc->cmdline);
+    g_slice_free(TaskCmdline, tc);
+}
+
+TaskCmdlineCache *task_cmdline_cache_new(GKeyFile *special_cases)
+{
+    TaskCmdlineCache *cache = g_new0(TaskCmdlineCache, 1);
+
+    cache->proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    cache->cache = g_hash_table_new_full(g_direct_hash, NULL, NULL,
+                                         (GDestroyNotify)task_cmdline_free);
+    cache->special_cases = special_cases;
+    return cache;
+}
+
+void task_cmdline_cache_free(TaskCmdlineCache *cache)
+{
+    if (cache->proc_fd >= 0)
+        close(cache->proc_fd);
+    g_hash_table_destroy(cache->cache);
+    g_free(cache);
+}
+
+/* reads file from /proc/<pid> into buf, returns number of bytes or -1 */
+static gssize proc_read_file(int proc_fd, GPid pid, const char *name,
+                             char *buf, gsize size)
+{
+    char path[64];
+    gssize len;
+    int fd;
+
+    snprintf(path, sizeof(path), "%lu" G_DIR_SEPARATOR_S "%s", (gulong)pid, name);
+    fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    len = read(fd, buf, size - 1);
+    close(fd);
+    if (len >= 0)
+        buf[len] = '\0';
+    return len;
+}
+
+/* returns change time of /proc/<pid> in nanoseconds, or 0 if it's gone */
+static gint64 proc_get_ctime(int proc_fd, GPid pid)
+{
+    char path[32];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%lu", (gulong)pid);
+    if (fstatat(proc_fd, path, &st, 0) < 0)
+        return 0;
+    return (gint64)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+}
+
+char *task_cmdline_cache_lookup(TaskCmdlineCache *cache, GPid pid)
+{
+    char buf[4096];
+    TaskCmdline *tc;
+    gint64 ctime;
+    gchar *cmdline = NULL;
+    gchar *p_char = NULL;
+
+    if (cache->proc_fd < 0 || (ctime = proc_get_ctime(cache->proc_fd, pid)) == 0)
+        return NULL;
+    tc = g_hash_table_lookup(cache->cache, GINT_TO_POINTER(pid));
+    if (tc != NULL && tc->ctime == ctime)
+        return g_strdup(tc->cmdline);
+
+    if (proc_read_file(cache->proc_fd, pid, "cmdline", buf, sizeof(buf)) >= 0)
+    {
+        p_char = strchr(buf, '\n');
+        if(p_char != NULL) *p_char = '\0';
+        p_char = strrchr(buf, G_DIR_SEPARATOR);
+        if (p_char != NULL) p_char++;
+        else p_char = buf;
+        if(strcmp(p_char, "python") == 0)
+        {
+            if (proc_read_file(cache->proc_fd, pid, "comm", buf, sizeof(buf)) >= 0)
+            {
+                p_char = strchr(buf, '\n');
+                if(p_char != NULL) *p_char = '\0';
+                cmdline = g_strdup(buf);
+            }
+        }
+        else
+        {
+            cmdline = g_key_file_get_string(cache->special_cases,
+                                            "special_cases", p_char, NULL);
+            if (cmdline == NULL) /* not found this key */
+                cmdline = g_strdup(buf);
+        }
+    }
+
+    /* stale pids are never removed from cache so drop it all if it's full */
+    if (g_hash_table_size(cache->cache) >= CMDLINE_CACHE_SIZE)
+        g_hash_table_remove_all(cache->cache);
+    tc = g_slice_new(TaskCmdline);
+    tc->ctime = ctime;
+    tc->cmdline = g_strdup(cmdline);
+    g_hash_table_replace(cache->cache, GINT_TO_POINTER(pid), tc);
+    return cmdline;
+}
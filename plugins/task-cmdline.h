@@ -0,0 +1,44 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __TASK_CMDLINE_H__
+#define __TASK_CMDLINE_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Resolves executables of processes which own task windows, so they can be
+   matched against launch buttons. Results are cached by pid together with
+   change time of /proc/<pid>, which is checked with fstatat() on every
+   lookup, so a reused pid is not mistaken for the old process. All files
+   are read with openat() from /proc held open. */
+
+typedef struct _TaskCmdlineCache TaskCmdlineCache;
+
+/* special_cases maps executables to launchers in group "special_cases", it
+   is not copied so should be kept until cache is freed */
+TaskCmdlineCache *task_cmdline_cache_new(GKeyFile *special_cases);
+void task_cmdline_cache_free(TaskCmdlineCache *cache);
+
+/* returns newly allocated executable of process or NULL */
+char *task_cmdline_cache_lookup(TaskCmdlineCache *cache, GPid pid);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Replays a synthetic stream of X events against the task window index and
+   against the walk over all buttons and their windows which was used
+   before, to compare cost of finding the button owning a window.
+
+   Usage: task-index-bench [windows [events]]
+
+   Most events come in floods for the same window, as ConfigureNotify does
+   while a window is dragged, the rest are PropertyNotify for random windows
+   and events for windows which have no button. At the end windows are
+   opened and closed at random and the index is checked to be in step. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "task-index.h"
+
+typedef struct {
+    GList *details;             /* windows grouped on this button */
+} Button;
+
+typedef struct {
+    gulong win;
+    Button *button;
+} Details;
+
+static GList *buttons = NULL;   /* as children of the taskbar grid */
+static GObject *grid;
+
+/* the way task_lookup() did it before the index */
+static Button *walk_lookup(gulong win)
+{
+    GList *children = g_list_copy(buttons), *l, *d;
+    Button *found = NULL;
+
+    for (l = children; l && !found; l = l->next)
+        for (d = ((Button *)l->data)->details; d; d = d->next)
+            if (((Details *)d->data)->win == win)
+            {
+                found = l->data;
+                break;
+            }
+    g_list_free(children);
+    return found;
+}
+
+static Button *index_lookup(gulong win)
+{
+    Details *details = task_index_lookup(grid, win);
+
+    return details ? details->button : NULL;
+}
+
+static void window_open(Button *button, gulong win)
+{
+    Details *details = g_new0(Details, 1);
+
+    details->win = win;
+    details->button = button;
+    button->details = g_list_append(button->details, details);
+    task_index_add(grid, win, details);
+}
+
+static void window_close(Details *details)
+{
+    Button *button = details->button;
+
+    task_index_remove(grid, details->win, details);
+    button->details = g_list_remove(button->details, details);
+    g_free(details);
+}
+
+static gulong *make_events(GRand *rand, guint n_windows, guint n_events)
+{
+    gulong *events = g_new(gulong, n_events);
+    guint i = 0, run;
+    gulong win;
+
+    while (i < n_events)
+    {
+        switch (g_rand_int_range(rand, 0, 10))
+        {
+        case 0: /* event for a window without button */
+            events[i++] = 0x100000 + g_rand_int_range(rand, 0, 1000);
+            break;
+        case 1: case 2: case 3: /* PropertyNotify */
+            events[i++] = 0x400000 + g_rand_int_range(rand, 0, n_windows);
+            break;
+        default: /* ConfigureNotify flood while dragging */
+            win = 0x400000 + g_rand_int_range(rand, 0, n_windows);
+            for (run = 50; run > 0 && i < n_events; run--)
+                events[i++] = win;
+        }
+    }
+    return events;
+}
+
+typedef Button *(*LookupFunc)(gulong win);
+
+static gint64 replay(LookupFunc lookup, const gulong *events, guint n_events,
+                     guint *found)
+{
+    gint64 start = g_get_monotonic_time();
+    guint i;
+
+    *found = 0;
+    for (i = 0; i < n_events; i++)
+        if (lookup(events[i]))
+            (*found)++;
+    return g_get_monotonic_time() - start;
+}
+
+int main(int argc, char **argv)
+{
+    guint n_windows = argc > 1 ? atoi(argv[1]) : 500;
+    guint n_events = argc > 2 ? atoi(argv[2]) : 200000;
+    GRand *rand = g_rand_new_with_seed(1);
+    Button *button = NULL;
+    gulong *events;
+    gint64 walk_time, index_time;
+    guint walk_found, index_found, i, churn;
+    GList *l, *d;
+
+    if (n_windows == 0 || n_events == 0)
+    {
+        fprintf(stderr, "usage: %s [windows [events]]\n", argv[0]);
+        return 2;
+    }
+    grid = g_object_new(G_TYPE_OBJECT, NULL);
+    /* group windows by 1...4 on a button, like windows of the same class */
+    for (i = 0; i < n_windows; i++)
+    {
+        if (button == NULL || g_rand_int_range(rand, 0, 3) == 0)
+        {
+            button = g_new0(Button, 1);
+            buttons = g_list_append(buttons, button);
+        }
+        window_open(button, 0x400000 + i);
+    }
+    events = make_events(rand, n_windows, n_events);
+
+    walk_time = replay(walk_lookup, events, n_events, &walk_found);
+    index_time = replay(index_lookup, events, n_events, &index_found);
+    printf("%u windows on %u buttons, %u events\n", n_windows,
+           g_list_length(buttons), n_events);
+    printf("  walk:  %8.1f ns/event\n", (double)walk_time * 1000 / n_events);
+    printf("  index: %8.1f ns/event\n", (double)index_time * 1000 / n_events);
+    if (walk_found != index_found)
+    {
+        fprintf(stderr, "lookups differ: %u vs %u found\n", walk_found, index_found);
+        return 1;
+    }
+
+    /* window open and close keep the index in step */
+    for (churn = 0; churn < n_events / 100; churn++)
+    {
+        button = g_list_nth_data(buttons, g_rand_int_range(rand, 0, g_list_length(buttons)));
+        if (button->details && button->details->next)
+            window_close(button->details->data);
+        else
+            window_open(button, 0x800000 + churn);
+    }
+    for (l = buttons; l; l = l->next)
+        for (d = ((Button *)l->data)->details; d; d = d->next)
+            if (index_lookup(((Details *)d->data)->win) != l->data)
+            {
+                fprintf(stderr, "index is out of step after open/close\n");
+                return 1;
+            }
+    g_free(events);
+    g_object_unref(grid);
+    g_rand_free(rand);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "task-index.h"
+
+static GQuark task_index_quark = 0;
+
+static GHashTable *task_index_get(GObject *container, gboolean create)
+{
+    GHashTable *index;
+
+    /* quark is used instead of string key since it's done on each event */
+    if (task_index_quark == 0)
+        task_index_quark = g_quark_from_static_string("task-button-index");
+    index = g_object_get_qdata(container, task_index_quark);
+    if (index == NULL && create)
+    {
+        index = g_hash_table_new(g_direct_hash, NULL);
+        g_object_set_qdata_full(container, task_index_quark, index,
+                                (GDestroyNotify)g_hash_table_destroy);
+    }
+    return index;
+}
+
+void task_index_add(GObject *container, gulong win, gpointer data)
+{
+    g_hash_table_insert(task_index_get(container, TRUE),
+                        GUINT_TO_POINTER(win), data);
+}
+
+void task_index_remove(GObject *container, gulong win, gpointer data)
+{
+    GHashTable *index = task_index_get(container, FALSE);
+
+    /* window might be moved to another button already */
+    if (index && g_hash_table_lookup(index, GUINT_TO_POINTER(win)) == data)
+        g_hash_table_remove(index, GUINT_TO_POINTER(win));
+}
+
+gpointer task_index_lookup(GObject *container, gulong win)
+{
+    GHashTable *index = task_index_get(container, FALSE);
+
+    return index ? g_hash_table_lookup(index, GUINT_TO_POINTER(win)) : NULL;
+}
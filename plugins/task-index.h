@@ -0,0 +1,42 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __TASK_INDEX_H__
+#define __TASK_INDEX_H__ 1
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Index of X windows shown by task buttons. It is kept on the container of
+   the buttons, so the owner of any window is found without walking all the
+   buttons and their windows. Windows are given as gulong to not depend on
+   X headers, values are opaque to the index. */
+
+/* adds window into index of container, replacing previous value if any */
+void task_index_add(GObject *container, gulong win, gpointer data);
+
+/* removes window from index of container if it still maps to data */
+void task_index_remove(GObject *container, gulong win, gpointer data);
+
+/* returns data added for the window or NULL */
+gpointer task_index_lookup(GObject *container, gulong win);
+
+G_END_DECLS
+
+#endif
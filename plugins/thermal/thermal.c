@@ -35,6 +35,8 @@
 
 #include "plugin.h"
 #include "misc.h"
+#include "sampler.h"
+#include "metrics.h"
 
 #include "dbg.h"
 
@@ -48,6 +50,8 @@
 #define SYSFS_THERMAL_TEMPF  "temp"
 #define SYSFS_THERMAL_TRIP  "trip_point_0_temp"
 
+#define UPDATE_PERIOD 3000 /* ms */
+
 #define MAX_NUM_SENSORS 10
 #define MAX_AUTOMATIC_CRITICAL_TEMP 150 /* in degrees Celsius */
 
@@ -153,28 +157,20 @@ proc_get_temperature(char const* sensor_path){
     return -1;
 }
 
+/* Sensor files are kept open by the shared sampler, a reading made within
+   the same update (e.g. by another instance) is reused. */
 static gint _get_reading(const char *path, gboolean quiet)
 {
-    FILE *state;
-    char buf[256];
-    char* pstr;
+    const LXPanelSample *sample;
 
-    if (!(state = fopen(path, "r"))) {
+    sample = lxpanel_sampler_read(LXPANEL_SAMPLE_VALUE, path, UPDATE_PERIOD / 2);
+    if (!sample->valid) {
         if (!quiet)
-            g_warning("thermal: cannot open %s", path);
+            g_warning("thermal: cannot read %s", path);
         return -1;
     }
 
-    while( fgets(buf, 256, state) &&
-            ! ( pstr = buf ) );
-    if( pstr )
-    {
-        fclose(state);
-        return atoi(pstr)/1000;
-    }
-
-    fclose(state);
-    return -1;
+    return sample->value / 1000;
 }
 
 static gint
@@ -306,12 +302,20 @@ update_display(thermal *th)
     gtk_widget_set_tooltip_text(th->namew, th->tip->str);
 }
 
-static gboolean update_display_timeout(gpointer user_data)
+static void update_display_timeout(const LXPanelSample *tick, gpointer user_data)
 {
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
-    update_display(user_data);
-    return TRUE; /* repeat later */
+    thermal *th = user_data;
+    char name[64];
+    int i;
+
+    update_display(th);
+
+    if (lxpanel_metrics_enabled())
+        for (i = 0; i < th->numsensors; i++)
+        {
+            g_snprintf(name, sizeof(name), "thermal.%s", th->sensor_name[i]);
+            lxpanel_metrics_publish(name, "C", tick->time, th->temperature[i]);
+        }
 }
 
 static int
@@ -511,7 +515,7 @@ thermal_destructor(gpointer user_data)
   g_free(th->str_cl_normal);
   g_free(th->str_cl_warning1);
   g_free(th->str_cl_warning2);
-  g_source_remove(th->timer);
+  lxpanel_sampler_unsubscribe(th->timer);
   g_free(th);
   RET();
 }
@@ -569,7 +573,8 @@ thermal_constructor(LXPanel *panel, config_setting_t *settings)
     gtk_widget_show(th->namew);
 
     update_display(th);
-    th->timer = g_timeout_add_seconds(3, (GSourceFunc) update_display_timeout, (gpointer)th);
+    th->timer = lxpanel_sampler_subscribe(LXPANEL_SAMPLE_TICK, NULL, UPDATE_PERIOD,
+                                          update_display_timeout, th);
 
     RET(p);
 }
@@ -603,6 +608,7 @@ LXPanelPluginInit fm_module_init_lxpanel_gtk = {
 
     .new_instance = thermal_constructor,
     .config = config,
+    .non_critical = TRUE
 };
 
 
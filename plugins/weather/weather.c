@@ -418,6 +418,7 @@ LXPanelPluginInit fm_module_init_lxpanel_gtk =
     // API functions
     .new_instance = weather_constructor,
     .config = weather_configure,
-    .reconfigure = weather_configuration_changed
+    .reconfigure = weather_configuration_changed,
+    .non_critical = TRUE
   };
 #endif /* USE_STANDALONE */
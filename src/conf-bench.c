@@ -0,0 +1,110 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Reads a generated panel config with many plugins and launchers, parsing
+   the text each time, and through the compiled cache both when it has to
+   be made (cold) and when it is valid (warm). Reports time per read.
+
+   Usage: conf-bench [plugins] [rounds] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "conf.h"
+
+#define BUTTONS_PER_PLUGIN 8
+
+static gboolean write_config(const char *filename, guint plugins)
+{
+    GString *s = g_string_new("Global {\n  edge=bottom\n  height=36\n}\n");
+    gboolean ok;
+    guint i, j;
+
+    for (i = 0; i < plugins; i++)
+    {
+        g_string_append(s, "Plugin {\n  type=launchbar\n  Config {\n");
+        for (j = 0; j < BUTTONS_PER_PLUGIN; j++)
+            g_string_append_printf(s, "    Button {\n      id=app%u-%u.desktop\n    }\n",
+                                   i, j);
+        g_string_append_printf(s, "    Tooltip=\"Launchers, set %u\"\n  }\n}\n", i);
+    }
+    ok = g_file_set_contents(filename, s->str, s->len, NULL);
+    g_string_free(s, TRUE);
+    return ok;
+}
+
+typedef gboolean (*ReadFunc)(PanelConf *config, const char *filename);
+
+static void run(const char *what, ReadFunc read, const char *filename,
+                guint rounds, gboolean cold)
+{
+    PanelConf *config;
+    gint64 time = 0, start;
+    guint i;
+
+    for (i = 0; i < rounds; i++)
+    {
+        if (cold)
+            config_remove_cache(filename);
+        config = config_new();
+        start = g_get_monotonic_time();
+        if (!read(config, filename))
+        {
+            fprintf(stderr, "%s: reading %s failed\n", what, filename);
+            exit(1);
+        }
+        time += g_get_monotonic_time() - start;
+        config_destroy(config);
+    }
+    printf("  %-14s %8.3f ms/read\n", what, (double)time / rounds / 1000);
+}
+
+int main(int argc, char **argv)
+{
+    guint plugins = argc > 1 ? atoi(argv[1]) : 2000;
+    guint rounds = argc > 2 ? atoi(argv[2]) : 20;
+    char *dir, *filename;
+    struct stat st;
+
+    if (plugins == 0 || rounds == 0)
+    {
+        fprintf(stderr, "usage: %s [plugins] [rounds]\n", argv[0]);
+        return 2;
+    }
+    dir = g_dir_make_tmp("conf-bench-XXXXXX", NULL);
+    if (dir == NULL)
+        return 1;
+    filename = g_build_filename(dir, "panel", NULL);
+    if (!write_config(filename, plugins) || stat(filename, &st) < 0)
+        return 1;
+    printf("%u plugins, %u launchers, %ld bytes, %u rounds\n", plugins,
+           plugins * BUTTONS_PER_PLUGIN, (long)st.st_size, rounds);
+
+    run("text:", config_read_file, filename, rounds, FALSE);
+    run("cache, cold:", config_read_file_cached, filename, rounds, TRUE);
+    run("cache, warm:", config_read_file_cached, filename, rounds, FALSE);
+
+    config_remove_cache(filename);
+    unlink(filename);
+    rmdir(dir);
+    g_free(filename);
+    g_free(dir);
+    return 0;
+}
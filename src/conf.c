@@ -28,6 +28,9 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 struct _config_setting_t
 {
@@ -36,26 +39,71 @@ struct _config_setting_t
     PanelConfType type;
     PanelConfSaveHook hook;
     gpointer hook_data;
+    gboolean name_borrowed : 1; /* name points into config text, don't free it */
+    gboolean str_borrowed : 1; /* the same for string value */
     char *name;
+    GHashTable *members; /* index of group members by name, built on demand */
     union {
         gint num; /* for integer or boolean */
         gchar *str; /* for string */
-        config_setting_t *first; /* for group or list */
+        struct {
+            config_setting_t *first; /* for group or list */
+            config_setting_t *last; /* to append without walking list */
+        };
     };
 };
 
 struct _PanelConf
 {
     config_setting_t *root;
+    GSList *maps; /* mapped files which settings may point into */
+    GSList *texts; /* the same for files which could not be mapped */
 };
 
+/* groups with more members than this get a hash index for lookups */
+#define CONFIG_INDEX_THRESHOLD 8
+
+static void _config_index_build(config_setting_t *setting)
+{
+    config_setting_t *s;
+
+    setting->members = g_hash_table_new(g_str_hash, g_str_equal);
+    for (s = setting->first; s; s = s->next)
+        /* the first one wins, the same as with linear search */
+        if (s->name && g_hash_table_lookup(setting->members, s->name) == NULL)
+            g_hash_table_insert(setting->members, s->name, s);
+}
+
+static inline void _config_index_add(config_setting_t *parent, config_setting_t *setting)
+{
+    if (parent->members && setting->name &&
+        g_hash_table_lookup(parent->members, setting->name) == NULL)
+        g_hash_table_insert(parent->members, setting->name, setting);
+}
+
+static inline void _config_index_remove(config_setting_t *parent, config_setting_t *setting)
+{
+    /* names are unique within group so there is no other one to index */
+    if (parent->members && setting->name &&
+        g_hash_table_lookup(parent->members, setting->name) == setting)
+        g_hash_table_remove(parent->members, setting->name);
+}
+
+/* settings loaded from file keep pointers into the file text until changed */
 static config_setting_t *_config_setting_t_new(config_setting_t *parent, int index,
-                                               const char *name, PanelConfType type)
+                                               const char *name, PanelConfType type,
+                                               gboolean borrow)
 {
     config_setting_t *s;
     s = g_slice_new0(config_setting_t);
     s->type = type;
-    s->name = g_strdup(name);
+    if (name && (borrow || name[0] == '\0'))
+    {
+        s->name = (name[0] == '\0') ? "" : (char *)name;
+        s->name_borrowed = TRUE;
+    }
+    else
+        s->name = g_strdup(name);
     if (parent == NULL || (parent->type != PANEL_CONF_TYPE_GROUP && parent->type != PANEL_CONF_TYPE_LIST))
         return s;
     s->parent = parent;
@@ -64,6 +112,8 @@ static config_setting_t *_config_setting_t_new(config_setting_t *parent, int ind
         s->next = parent->first;
         parent->first = s;
     }
+    else if (index < 0)
+        parent->last->next = s;
     else
     {
         for (parent = parent->first; parent->next && index != 1; parent = parent->next)
@@ -72,20 +122,27 @@ static config_setting_t *_config_setting_t_new(config_setting_t *parent, int ind
         s->next = parent->next;
         parent->next = s;
     }
+    if (s->next == NULL)
+        s->parent->last = s;
+    _config_index_add(s->parent, s);
     return s;
 }
 
 /* frees data, not removes from parent */
 static void _config_setting_t_free(config_setting_t *setting)
 {
-    g_free(setting->name);
+    if (!setting->name_borrowed)
+        g_free(setting->name);
     switch (setting->type)
     {
     case PANEL_CONF_TYPE_STRING:
-        g_free(setting->str);
+        if (!setting->str_borrowed)
+            g_free(setting->str);
         break;
     case PANEL_CONF_TYPE_GROUP:
     case PANEL_CONF_TYPE_LIST:
+        if (setting->members)
+            g_hash_table_destroy(setting->members);
         while (setting->first)
         {
             config_setting_t *s = setting->first;
@@ -105,8 +162,13 @@ static void _config_setting_t_remove(config_setting_t *setting)
     g_return_if_fail(setting->parent);
     g_return_if_fail(setting->parent->type == PANEL_CONF_TYPE_GROUP || setting->parent->type == PANEL_CONF_TYPE_LIST);
     /* remove from parent */
+    _config_index_remove(setting->parent, setting);
     if (setting->parent->first == setting)
+    {
         setting->parent->first = setting->next;
+        if (setting->next == NULL)
+            setting->parent->last = NULL;
+    }
     else
     {
         config_setting_t *s = setting->parent->first;
@@ -114,6 +176,8 @@ static void _config_setting_t_remove(config_setting_t *setting)
             s = s->next;
         g_assert(s->next != NULL);
         s->next = setting->next;
+        if (s->next == NULL)
+            setting->parent->last = s;
     }
     /* free the data */
     _config_setting_t_free(setting);
@@ -122,12 +186,39 @@ static void _config_setting_t_remove(config_setting_t *setting)
 static config_setting_t * _config_setting_get_member(const config_setting_t * setting, const char * name)
 {
     config_setting_t *s;
-    for (s = setting->first; s; s = s->next)
+    guint n = 0;
+
+    if (setting->members)
+        return g_hash_table_lookup(setting->members, name);
+    for (s = setting->first; s; s = s->next, n++)
         if (g_strcmp0(s->name, name) == 0)
             break;
+    /* group became big enough, index it for the next lookups */
+    if (n > CONFIG_INDEX_THRESHOLD && setting->type == PANEL_CONF_TYPE_GROUP)
+        _config_index_build((config_setting_t *)setting);
     return s;
 }
 
+static config_setting_t * _config_setting_add(config_setting_t * parent, const char * name,
+                                              PanelConfType type, gboolean borrow);
+
+static void _config_setting_set_name(config_setting_t * setting, const char * name)
+{
+    if (!setting->name_borrowed)
+        g_free(setting->name);
+    setting->name = g_strdup(name);
+    setting->name_borrowed = FALSE;
+}
+
+static void _config_setting_set_str(config_setting_t * setting, char * str,
+                                    gboolean borrow)
+{
+    if (!setting->str_borrowed)
+        g_free(setting->str);
+    setting->str = str;
+    setting->str_borrowed = borrow;
+}
+
 /* returns either new or existing setting struct, NULL on error or conflict */
 static config_setting_t * _config_setting_try_add(config_setting_t * parent,
                                                   const char * name,
@@ -141,38 +232,74 @@ static config_setting_t * _config_setting_try_add(config_setting_t * parent,
     if (parent->type == PANEL_CONF_TYPE_GROUP &&
         (s = _config_setting_get_member(parent, name)))
         return (s->type == type) ? s : NULL;
-    return _config_setting_t_new(parent, -1, name, type);
+    return _config_setting_t_new(parent, -1, name, type, TRUE);
 }
 
 PanelConf *config_new(void)
 {
-    PanelConf *c = g_slice_new(PanelConf);
-    c->root = _config_setting_t_new(NULL, -1, NULL, PANEL_CONF_TYPE_GROUP);
+    PanelConf *c = g_slice_new0(PanelConf);
+    c->root = _config_setting_t_new(NULL, -1, NULL, PANEL_CONF_TYPE_GROUP, FALSE);
     return c;
 }
 
 void config_destroy(PanelConf * config)
 {
     _config_setting_t_free(config->root);
+    g_slist_free_full(config->maps, (GDestroyNotify)g_mapped_file_unref);
+    g_slist_free_full(config->texts, g_free);
     g_slice_free(PanelConf, config);
 }
 
+/* returns NUL-terminated writable text of file which stays valid while
+   config exists, so parser can terminate tokens in place and settings
+   can point into it instead of copying each key and value */
+static char *_config_load_text(PanelConf * config, const char * filename)
+{
+    GMappedFile *map;
+    char *text;
+    gsize size, i, page;
+
+    /* private writable mapping: changes made by parser are never written back */
+    map = g_mapped_file_new(filename, TRUE, NULL);
+    if (map != NULL)
+    {
+        text = g_mapped_file_get_contents(map);
+        size = g_mapped_file_get_length(map);
+        /* pages which are not written stay shared with the file and would
+           change or fault if it is rewritten in place, so copy all of them
+           now while settings may point into any of them */
+        page = sysconf(_SC_PAGESIZE);
+        for (i = 0; i < size; i += page)
+            ((volatile char *)text)[i] = text[i];
+        if (size > 0 && text[size - 1] == '\n')
+            /* parser handles end of text the same way as end of line */
+            text[size - 1] = '\0';
+        else if (size == 0 || size % page == 0)
+            /* no zero-filled page tail to terminate the text */
+            text = NULL;
+        if (text != NULL)
+        {
+            config->maps = g_slist_prepend(config->maps, map);
+            return text;
+        }
+        g_mapped_file_unref(map);
+    }
+    if (!g_file_get_contents(filename, &text, NULL, NULL))
+        return NULL;
+    config->texts = g_slist_prepend(config->texts, text);
+    return text;
+}
+
 gboolean config_read_file(PanelConf * config, const char * filename)
 {
-    FILE *f = fopen(filename, "r");
-    size_t size;
+    long size;
     char *buff, *c, *name, *end, *p;
     config_setting_t *s, *parent;
+    gboolean eol = FALSE;
 
-    if (f == NULL)
+    buff = _config_load_text(config, filename);
+    if (buff == NULL)
         return FALSE;
-    fseek(f, 0L, SEEK_END);
-    size = ftell(f);
-    rewind(f);
-    buff = g_malloc(size + 1);
-    size = fread(buff, 1, size, f);
-    fclose(f);
-    buff[size] = '\0';
     name = NULL;
     parent = config->root;
     for (c = buff; *c; )
@@ -238,7 +365,9 @@ _skip_all:
                 }
                 if (*end == '"')
                 {
+                    *p = '\0';
                     end++;
+                    eol = FALSE;
                     goto _make_string;
                 }
                 else /* incomplete string */
@@ -248,17 +377,20 @@ _skip_all:
             {
                 for (end = c; *end && *end != '\n'; )
                     end++;
-                p = end;
+                eol = (*end == '\n');
+                if (eol)
+                    *end++ = '\0'; /* terminate value in place */
 _make_string:
                 s = _config_setting_try_add(parent, name, PANEL_CONF_TYPE_STRING);
                 if (s)
                 {
-                    g_free(s->str);
-                    s->str = g_strndup(c, p - c);
+                    _config_setting_set_str(s, c, TRUE);
                     /* g_debug("config loader: got new string %s: %s", name, s->str); */
                 }
                 else
                     g_warning("config: duplicate setting '%s' conflicts, ignored", name);
+                if (eol) /* line end was consumed with the value */
+                    name = NULL;
             }
             c = end;
             break;
@@ -267,7 +399,7 @@ _make_string:
             if (name)
             {
                 *c = '\0';
-                s = config_setting_add(parent, name, PANEL_CONF_TYPE_GROUP);
+                s = _config_setting_add(parent, name, PANEL_CONF_TYPE_GROUP, TRUE);
             }
             else
                 s = NULL;
@@ -295,10 +427,278 @@ _make_string:
             c++;
         }
     }
-    g_free(buff);
     return TRUE;
 }
 
+/* Compiled cache of a config file: header, then nodes of the tree in
+   pre-order, then table of NUL-terminated strings the nodes refer to.
+   It is host specific and valid only for the file state it was made of. */
+#define CONFIG_CACHE_MAGIC "LXPCONF"
+#define CONFIG_CACHE_VERSION 1
+#define CONFIG_CACHE_NONE G_MAXUINT32
+
+typedef struct
+{
+    char magic[8];
+    guint32 version;
+    guint32 n_nodes;
+    guint32 strings_size;
+    guint32 src_mtime_nsec;
+    gint64 src_mtime;
+    guint64 src_size;
+    guint64 src_ino;
+    guint64 hash; /* of nodes and strings */
+} ConfigCacheHeader;
+
+typedef struct
+{
+    guint32 type;
+    guint32 name; /* offset of string or CONFIG_CACHE_NONE */
+    guint32 value; /* integer, offset of string or number of children */
+} ConfigCacheNode;
+
+static guint64 _config_cache_hash(const guchar *data, gsize len)
+{
+    guint64 hash = 14695981039346656037ULL; /* FNV-1a */
+
+    while (len--)
+    {
+        hash ^= *data++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static char *_config_cache_name(const char *filename)
+{
+    char *dir = g_path_get_dirname(filename);
+    char *base = g_path_get_basename(filename);
+    char *name = g_strdup_printf(".%s.cache", base);
+    char *path = g_build_filename(dir, name, NULL);
+
+    g_free(dir);
+    g_free(base);
+    g_free(name);
+    return path;
+}
+
+static guint32 _config_cache_add_string(GString *strings, GHashTable *offsets,
+                                        const char *str)
+{
+    gpointer offset;
+
+    if (str == NULL)
+        return CONFIG_CACHE_NONE;
+    offset = g_hash_table_lookup(offsets, str);
+    if (offset == NULL)
+    {
+        offset = GUINT_TO_POINTER(strings->len + 1);
+        g_hash_table_insert(offsets, (gpointer)str, offset);
+        g_string_append_len(strings, str, strlen(str) + 1);
+    }
+    return GPOINTER_TO_UINT(offset) - 1;
+}
+
+static void _config_cache_add_node(const config_setting_t *setting, GArray *nodes,
+                                   GString *strings, GHashTable *offsets)
+{
+    ConfigCacheNode node;
+    config_setting_t *s;
+
+    node.type = setting->type;
+    node.name = _config_cache_add_string(strings, offsets, setting->name);
+    switch (setting->type)
+    {
+    case PANEL_CONF_TYPE_INT:
+        node.value = (guint32)setting->num;
+        break;
+    case PANEL_CONF_TYPE_STRING:
+        node.value = _config_cache_add_string(strings, offsets, setting->str);
+        break;
+    case PANEL_CONF_TYPE_GROUP:
+    case PANEL_CONF_TYPE_LIST:
+        node.value = 0;
+        for (s = setting->first; s; s = s->next)
+            node.value++;
+        break;
+    }
+    g_array_append_val(nodes, node);
+    if (setting->type == PANEL_CONF_TYPE_GROUP || setting->type == PANEL_CONF_TYPE_LIST)
+        for (s = setting->first; s; s = s->next)
+            _config_cache_add_node(s, nodes, strings, offsets);
+}
+
+static gboolean _config_write_cache(PanelConf * config, const char * cache,
+                                    const struct stat * st)
+{
+    ConfigCacheHeader header;
+    GArray *nodes = g_array_new(FALSE, FALSE, sizeof(ConfigCacheNode));
+    GString *out = g_string_sized_new(4096);
+    GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+    gboolean ok;
+
+    /* strings are collected first then nodes are put before them */
+    g_string_append_len(out, "", 1);
+    g_hash_table_insert(offsets, "", GUINT_TO_POINTER(1));
+    _config_cache_add_node(config->root, nodes, out, offsets);
+    g_hash_table_destroy(offsets);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(CONFIG_CACHE_MAGIC));
+    header.version = CONFIG_CACHE_VERSION;
+    header.n_nodes = nodes->len;
+    header.strings_size = out->len;
+    header.src_mtime = st->st_mtim.tv_sec;
+    header.src_mtime_nsec = st->st_mtim.tv_nsec;
+    header.src_size = st->st_size;
+    header.src_ino = st->st_ino;
+    g_string_prepend_len(out, nodes->data, nodes->len * sizeof(ConfigCacheNode));
+    header.hash = _config_cache_hash((guchar *)out->str, out->len);
+    g_string_prepend_len(out, (char *)&header, sizeof(header));
+    /* it's replaced atomically so readers see either old or new one */
+    ok = g_file_set_contents(cache, out->str, out->len, NULL);
+    g_string_free(out, TRUE);
+    g_array_free(nodes, TRUE);
+    return ok;
+}
+
+/* creates count settings in parent from nodes starting at i, returns index
+   of next node or CONFIG_CACHE_NONE if data are invalid */
+static guint32 _config_cache_load_children(config_setting_t *parent, guint32 count,
+                                           const ConfigCacheNode *nodes, guint32 i,
+                                           guint32 n_nodes, const char *strings,
+                                           guint32 strings_size)
+{
+    config_setting_t *s;
+    const ConfigCacheNode *node;
+
+    while (count--)
+    {
+        if (i >= n_nodes)
+            return CONFIG_CACHE_NONE;
+        node = &nodes[i++];
+        if (node->type > PANEL_CONF_TYPE_LIST || node->name >= strings_size ||
+            (node->type == PANEL_CONF_TYPE_STRING && node->value != CONFIG_CACHE_NONE &&
+             node->value >= strings_size))
+            return CONFIG_CACHE_NONE;
+        /* append settings directly, no need to walk list for each one */
+        s = _config_setting_t_new(NULL, -1, &strings[node->name], node->type, TRUE);
+        s->parent = parent;
+        if (parent->last)
+            parent->last->next = s;
+        else
+            parent->first = s;
+        parent->last = s;
+        switch (node->type)
+        {
+        case PANEL_CONF_TYPE_INT:
+            s->num = (gint)node->value;
+            break;
+        case PANEL_CONF_TYPE_STRING:
+            if (node->value != CONFIG_CACHE_NONE)
+            {
+                s->str = (char *)&strings[node->value];
+                s->str_borrowed = TRUE;
+            }
+            break;
+        case PANEL_CONF_TYPE_GROUP:
+        case PANEL_CONF_TYPE_LIST:
+            i = _config_cache_load_children(s, node->value, nodes, i, n_nodes,
+                                            strings, strings_size);
+            if (i == CONFIG_CACHE_NONE)
+                return i;
+            break;
+        }
+    }
+    return i;
+}
+
+static gboolean _config_read_cache(PanelConf * config, const char * cache,
+                                   const struct stat * st)
+{
+    GMappedFile *map = g_mapped_file_new(cache, TRUE, NULL);
+    ConfigCacheHeader *header;
+    const ConfigCacheNode *nodes;
+    const char *strings;
+    gsize len;
+
+    if (map == NULL)
+        return FALSE;
+    len = g_mapped_file_get_length(map);
+    header = (ConfigCacheHeader *)g_mapped_file_get_contents(map);
+    if (len < sizeof(ConfigCacheHeader) ||
+        memcmp(header->magic, CONFIG_CACHE_MAGIC, sizeof(CONFIG_CACHE_MAGIC)) != 0 ||
+        header->version != CONFIG_CACHE_VERSION ||
+        /* is it made of the file as it is now? */
+        header->src_mtime != st->st_mtim.tv_sec ||
+        header->src_mtime_nsec != (guint32)st->st_mtim.tv_nsec ||
+        header->src_size != (guint64)st->st_size ||
+        header->src_ino != (guint64)st->st_ino ||
+        header->n_nodes == 0 || header->strings_size == 0 ||
+        header->n_nodes > (len - sizeof(ConfigCacheHeader)) / sizeof(ConfigCacheNode) ||
+        len != sizeof(ConfigCacheHeader) + header->n_nodes * sizeof(ConfigCacheNode)
+               + header->strings_size)
+        goto _invalid;
+    nodes = (const ConfigCacheNode *)(header + 1);
+    strings = (const char *)(nodes + header->n_nodes);
+    /* the last string should be terminated, so all of them are */
+    if (strings[header->strings_size - 1] != '\0' ||
+        header->hash != _config_cache_hash((const guchar *)nodes,
+                                           len - sizeof(ConfigCacheHeader)) ||
+        nodes[0].type != PANEL_CONF_TYPE_GROUP)
+        goto _invalid;
+    if (_config_cache_load_children(config->root, nodes[0].value, nodes, 1,
+                                    header->n_nodes, strings,
+                                    header->strings_size) != header->n_nodes)
+    {
+        /* drop what was created */
+        while (config->root->first)
+            _config_setting_t_remove(config->root->first);
+        goto _invalid;
+    }
+    /* settings point into it now */
+    config->maps = g_slist_prepend(config->maps, map);
+    return TRUE;
+
+_invalid:
+    g_mapped_file_unref(map);
+    return FALSE;
+}
+
+/* the same as config_read_file() but uses compiled cache of the file if it
+   is still valid, and makes new cache otherwise */
+gboolean config_read_file_cached(PanelConf * config, const char * filename)
+{
+    struct stat st;
+    char *cache, *dir;
+    gboolean ok;
+
+    if (stat(filename, &st) < 0)
+        return FALSE;
+    cache = _config_cache_name(filename);
+    /* cache can only be loaded into empty config */
+    if (config->root->first == NULL && _config_read_cache(config, cache, &st))
+        ok = TRUE;
+    else if ((ok = config_read_file(config, filename)))
+    {
+        /* don't try to write it next to system profile files */
+        dir = g_path_get_dirname(filename);
+        if (access(dir, W_OK) == 0)
+            _config_write_cache(config, cache, &st);
+        g_free(dir);
+    }
+    g_free(cache);
+    return ok;
+}
+
+/* removes compiled cache made by config_read_file_cached() for the file */
+void config_remove_cache(const char * filename)
+{
+    char *cache = _config_cache_name(filename);
+
+    unlink(cache);
+    g_free(cache);
+}
+
 #define SETTING_INDENT "  "
 
 static void _config_write_setting(const config_setting_t *setting, GString *buf,
@@ -376,20 +776,73 @@ static void _config_write_setting(const config_setting_t *setting, GString *buf,
     g_string_truncate(buf, indent);
 }
 
-gboolean config_write_file(PanelConf * config, const char * filename)
+static void _config_write(PanelConf * config, FILE * f)
 {
-    FILE *f = fopen(filename, "w");
     GString *str;
-    if (f == NULL)
-        return FALSE;
     fputs("# lxpanel <profile> config file. Manually editing is not recommended.\n"
           "# Use preference dialog in lxpanel to adjust config when you can.\n\n", f);
     str = g_string_sized_new(128);
     _config_write_setting(config_setting_get_member(config->root, ""), str, NULL, f);
-    /* FIXME: handle errors */
-    fclose(f);
     g_string_free(str, TRUE);
-    return TRUE;
+}
+
+/* the file is replaced instead of rewritten in place since settings read
+   from it before may still point into its mapped pages */
+gboolean config_write_file(PanelConf * config, const char * filename)
+{
+    /* replace target of symlink, not symlink itself */
+    char *target = realpath(filename, NULL);
+    const char *path = target ? target : filename;
+    char *dir = g_path_get_dirname(path);
+    char *base = g_path_get_basename(path);
+    char *tmp = g_strdup_printf("%s/.%s.XXXXXX", dir, base);
+    int fd = g_mkstemp_full(tmp, O_WRONLY, 0666);
+    struct stat st;
+    FILE *f;
+    gboolean ok = FALSE;
+
+    if (fd < 0)
+        goto _done;
+    if (stat(path, &st) == 0)
+        fchmod(fd, st.st_mode & 07777);
+    f = fdopen(fd, "w");
+    if (f == NULL)
+    {
+        close(fd);
+        unlink(tmp);
+        goto _done;
+    }
+    _config_write(config, f);
+    ok = (fflush(f) == 0 && fsync(fd) == 0);
+    if (fclose(f) != 0)
+        ok = FALSE;
+    if (!ok || rename(tmp, path) < 0)
+    {
+        unlink(tmp);
+        ok = FALSE;
+    }
+_done:
+    g_free(tmp);
+    g_free(base);
+    g_free(dir);
+    free(target);
+    return ok;
+}
+
+/* the same as config_write_file() but into memory, result should be freed
+   with free(); save hooks of old plugins are called the same way */
+char * config_write_string(PanelConf * config, gsize * len)
+{
+    char *buf = NULL;
+    size_t size = 0;
+    FILE *f = open_memstream(&buf, &size);
+    if (f == NULL)
+        return NULL;
+    _config_write(config, f);
+    fclose(f);
+    if (len)
+        *len = size;
+    return buf;
 }
 
 /* it is used for old plugins only */
@@ -480,7 +933,8 @@ gboolean config_setting_lookup_string(const config_setting_t * setting,
 
 /* returns either new or existing setting struct, NULL on args error,
    removes old setting on conflict */
-config_setting_t * config_setting_add(config_setting_t * parent, const char * name, PanelConfType type)
+static config_setting_t * _config_setting_add(config_setting_t * parent, const char * name,
+                                              PanelConfType type, gboolean borrow)
 {
     config_setting_t *s;
     if (parent == NULL || (parent->type != PANEL_CONF_TYPE_GROUP && parent->type != PANEL_CONF_TYPE_LIST))
@@ -501,7 +955,12 @@ config_setting_t * config_setting_add(config_setting_t * parent, const char * na
             return s;
         _config_setting_t_remove(s);
     }
-    return _config_setting_t_new(parent, -1, name, type);
+    return _config_setting_t_new(parent, -1, name, type, borrow);
+}
+
+config_setting_t * config_setting_add(config_setting_t * parent, const char * name, PanelConfType type)
+{
+    return _config_setting_add(parent, name, type, FALSE);
 }
 
 
@@ -509,8 +968,11 @@ static void remove_from_parent(config_setting_t * setting)
 {
     config_setting_t *s;
 
+    _config_index_remove(setting->parent, setting);
     if (setting->parent->first == setting) {
         setting->parent->first = setting->next;
+        if (setting->next == NULL)
+            setting->parent->last = NULL;
         goto _isolate_setting;
     }
 
@@ -519,6 +981,8 @@ static void remove_from_parent(config_setting_t * setting)
             break;
     g_assert(s->next);
     s->next = setting->next;
+    if (s->next == NULL)
+        setting->parent->last = s;
 
 _isolate_setting:
     setting->next = NULL;
@@ -527,24 +991,20 @@ _isolate_setting:
 
 static void append_to_parent(config_setting_t * setting, config_setting_t * parent)
 {
-    config_setting_t *s;
-
     setting->parent = parent;
-    if (parent->first == NULL) {
+    _config_index_add(parent, setting);
+    if (parent->first == NULL)
         parent->first = setting;
-        return;
-    }
-
-    s = parent->first;
-    while (s->next)
-        s = s->next;
-    s->next = setting;
+    else
+        parent->last->next = setting;
+    parent->last = setting;
 }
 
 static void insert_after(config_setting_t * setting, config_setting_t * parent,
         config_setting_t * prev)
 {
     setting->parent = parent;
+    _config_index_add(parent, setting);
     if (prev == NULL) {
         setting->next = parent->first;
         parent->first = setting;
@@ -552,6 +1012,8 @@ static void insert_after(config_setting_t * setting, config_setting_t * parent,
         setting->next = prev->next;
         prev->next = setting;
     }
+    if (setting->next == NULL)
+        parent->last = setting;
 }
 
 gboolean config_setting_move_member(config_setting_t * setting, config_setting_t * parent, const char * name)
@@ -572,8 +1034,9 @@ gboolean config_setting_move_member(config_setting_t * setting, config_setting_t
     if (g_strcmp0(setting->name, name) != 0)
     {
 _rename:
-        g_free(setting->name);
-        setting->name = g_strdup(name);
+        _config_index_remove(setting->parent, setting);
+        _config_setting_set_name(setting, name);
+        _config_index_add(setting->parent, setting);
     }
     return TRUE;
 }
@@ -632,8 +1095,7 @@ gboolean config_setting_set_string(config_setting_t * setting, const char * valu
 {
     if (!setting || setting->type != PANEL_CONF_TYPE_STRING)
         return FALSE;
-    g_free(setting->str);
-    setting->str = g_strdup(value);
+    _config_setting_set_str(setting, g_strdup(value), FALSE);
     return TRUE;
 }
 
@@ -50,7 +50,10 @@ typedef void (*PanelConfSaveHook)(const config_setting_t * setting, FILE * f, gp
 PanelConf *config_new(void);
 void config_destroy(PanelConf * config);
 gboolean config_read_file(PanelConf * config, const char * filename);
+gboolean config_read_file_cached(PanelConf * config, const char * filename);
+void config_remove_cache(const char * filename);
 gboolean config_write_file(PanelConf * config, const char * filename);
+char * config_write_string(PanelConf * config, gsize * len);
 char * config_setting_to_string(const config_setting_t * setting);
 
 config_setting_t * config_root_setting(const PanelConf * config);
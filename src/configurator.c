@@ -42,8 +42,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <string.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <libfm/fm-gtk.h>
 
 #include "private.h"
@@ -88,8 +91,6 @@ static char* logout_cmd = NULL;
 static guint16 const alpha_scale_factor = 257;
 #endif
 
-void panel_config_save(Panel *p);
-
 static void update_opt_menu(GtkWidget *w, int ind);
 static void update_toggle_button(GtkWidget *w, gboolean n);
 static void modify_plugin( GtkTreeView* view );
@@ -614,7 +615,7 @@ on_sel_plugin_changed( GtkTreeSelection* tree_sel, GtkWidget* label )
         init = PLUGIN_CLASS(pl);
         gtk_label_set_text(GTK_LABEL(label),
                            g_dgettext(init->gettext_package, init->description));
-        gtk_widget_set_sensitive( edit_btn, init->config != NULL );
+        gtk_widget_set_sensitive( edit_btn, init->config != NULL && !PLUGIN_IS_PLACEHOLDER(pl) );
     }
 }
 
@@ -989,7 +990,7 @@ static void modify_plugin( GtkTreeView* view )
 
     gtk_tree_model_get( model, &it, COL_DATA, &pl, -1 );
     init = PLUGIN_CLASS(pl);
-    if (init->config)
+    if (init->config && !PLUGIN_IS_PLACEHOLDER(pl))
     {
         GtkWidget *dlg;
         LXPanel *panel = PLUGIN_PANEL(pl);
@@ -1492,25 +1493,184 @@ void panel_configure( LXPanel* panel, int sel_page )
     g_object_unref(builder);
 }
 
-void panel_config_save( Panel* p )
+#define CONFIG_SAVE_DELAY 500 /* ms */
+
+/* Config files are saved with write-behind: saves requested within the delay
+   are coalesced into one, the config is serialized on the main thread and
+   then written by a single writer thread in request order. */
+typedef struct {
+    char *path;
+    char *data;
+    gsize len;
+    GDestroyNotify free_data;
+} ConfigSaveJob;
+
+static guint config_save_delay = CONFIG_SAVE_DELAY;
+gboolean lxpanel_defer_plugins = FALSE;
+gboolean lxpanel_export_metrics = FALSE;
+gboolean lxpanel_config_cache = FALSE;
+static guint config_saves_coalesced = 0;
+static GSList *config_saves_pending = NULL; /* panels with save timer */
+static GThreadPool *config_writer = NULL;
+
+/* writes into temporary file and replaces the target file with it so
+   the config is never left half-written; the temporary file is hidden so
+   if it is left behind it is not taken for a panel config on next start;
+   if the config is a symlink then its target is replaced, with the same
+   mode as it had */
+static void config_save_job_run(gpointer data, gpointer unused)
+{
+    ConfigSaveJob *job = data;
+    char *target = realpath(job->path, NULL);
+    const char *path = target ? target : job->path;
+    char *dir = g_path_get_dirname(path);
+    char *base = g_path_get_basename(path);
+    char *tmp = g_strdup_printf("%s/.%s.XXXXXX", dir, base);
+    int fd = g_mkstemp_full(tmp, O_WRONLY, 0644);
+    struct stat st;
+    gsize done = 0;
+    gssize n;
+
+    if (fd < 0)
+    {
+        g_warning("can't open for write %s: %s", job->path, g_strerror(errno));
+        goto _done;
+    }
+    if (g_stat(path, &st) == 0)
+        fchmod(fd, st.st_mode & 07777);
+    while (done < job->len)
+    {
+        n = write(fd, job->data + done, job->len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    if (done < job->len || fsync(fd) < 0)
+    {
+        g_warning("can't write %s: %s", job->path, g_strerror(errno));
+        close(fd);
+        g_unlink(tmp);
+        goto _done;
+    }
+    close(fd);
+    if (g_rename(tmp, path) < 0)
+    {
+        g_warning("can't replace %s: %s", job->path, g_strerror(errno));
+        g_unlink(tmp);
+    }
+_done:
+    g_free(tmp);
+    g_free(base);
+    g_free(dir);
+    free(target);
+    job->free_data(job->data);
+    g_free(job->path);
+    g_slice_free(ConfigSaveJob, job);
+}
+
+/* takes ownership on path and data */
+static void config_save_queue(char *path, char *data, gsize len,
+                              GDestroyNotify free_data)
 {
-    gchar *fname;
+    ConfigSaveJob *job = g_slice_new(ConfigSaveJob);
 
-    fname = _user_config_file_name("panels", p->name);
-    /* existance of 'panels' dir ensured in main() */
+    job->path = path;
+    job->data = data;
+    job->len = len;
+    job->free_data = free_data;
+    if (config_writer == NULL)
+        config_writer = g_thread_pool_new(config_save_job_run, NULL, 1, FALSE, NULL);
+    g_thread_pool_push(config_writer, job, NULL);
+}
+
+static void panel_config_write(Panel *p)
+{
+    char *data;
+    gsize len;
 
-    if (!config_write_file(p->config, fname)) {
-        g_warning("can't open for write %s:", fname);
-        g_free( fname );
+    /* existance of 'panels' dir ensured in main() */
+    data = config_write_string(p->config, &len);
+    if (data == NULL)
+    {
+        g_warning("can't save config of panel %s", p->name);
         return;
     }
-    g_free( fname );
+    config_save_queue(_user_config_file_name("panels", p->name), data, len, free);
 
     /* save the global config file */
     save_global_config();
     p->config_changed = 0;
 }
 
+static gboolean panel_config_save_timeout(gpointer user_data)
+{
+    Panel *p = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    p->config_save_timer = 0;
+    config_saves_pending = g_slist_remove(config_saves_pending, p);
+    panel_config_write(p);
+    return FALSE;
+}
+
+void panel_config_save( Panel* p )
+{
+    if (p->config_save_timer)
+    {
+        /* will be written with the save which is already scheduled */
+        config_saves_coalesced++;
+        return;
+    }
+    p->config_save_timer = g_timeout_add(config_save_delay,
+                                         panel_config_save_timeout, p);
+    config_saves_pending = g_slist_prepend(config_saves_pending, p);
+}
+
+/* waits until all queued config files are written */
+static void config_writer_wait(void)
+{
+    if (config_writer)
+    {
+        /* it will be recreated on next save */
+        g_thread_pool_free(config_writer, FALSE, TRUE);
+        config_writer = NULL;
+    }
+}
+
+static void _panel_config_flush(Panel *p)
+{
+    if (p->config_save_timer)
+    {
+        g_source_remove(p->config_save_timer);
+        p->config_save_timer = 0;
+        config_saves_pending = g_slist_remove(config_saves_pending, p);
+        panel_config_write(p);
+    }
+}
+
+/* writes scheduled save of the panel now and waits until it's done */
+void panel_config_flush(Panel *p)
+{
+    _panel_config_flush(p);
+    config_writer_wait();
+}
+
+/* flushes saves of all panels, should be called before exit */
+void lxpanel_config_flush(void)
+{
+    while (config_saves_pending)
+        _panel_config_flush(config_saves_pending->data);
+    config_writer_wait();
+}
+
+guint lxpanel_config_get_coalesced_count(void)
+{
+    return config_saves_coalesced;
+}
+
 void lxpanel_config_save(LXPanel *p)
 {
     panel_config_save(p->priv);
@@ -1899,6 +2059,7 @@ GtkWidget* create_generic_config_dlg( const char* title, GtkWidget* parent,
 }
 
 #define COMMAND_GROUP "Command"
+#define CONFIG_GROUP "Config"
 
 void load_global_config()
 {
@@ -1936,6 +2097,19 @@ void load_global_config()
         GList *apps, *l;
 
         logout_cmd = g_key_file_get_string( kf, COMMAND_GROUP, "Logout", NULL );
+        /* coalescing window for config saves */
+        if (g_key_file_has_key(kf, CONFIG_GROUP, "SaveDelay", NULL))
+            config_save_delay = MAX(g_key_file_get_integer(kf, CONFIG_GROUP,
+                                                           "SaveDelay", NULL), 0);
+        /* create non-critical plugins after panels are shown */
+        lxpanel_defer_plugins = g_key_file_get_boolean(kf, CONFIG_GROUP,
+                                                       "DeferPlugins", NULL);
+        /* write samples of plugins into runtime dir for other tools */
+        lxpanel_export_metrics = g_key_file_get_boolean(kf, CONFIG_GROUP,
+                                                        "ExportMetrics", NULL);
+        /* keep compiled copies of panel configs to start faster */
+        lxpanel_config_cache = g_key_file_get_boolean(kf, CONFIG_GROUP,
+                                                      "CacheConfig", NULL);
         /* check for terminal setting on upgrade */
         if (fm_config->terminal == NULL)
         {
@@ -1979,16 +2153,25 @@ void load_global_config()
 
 static void save_global_config()
 {
-    char* file = _user_config_file_name("config", NULL);
-    FILE* f = fopen( file, "w" );
-    if( f )
-    {
-        fprintf( f, "[" COMMAND_GROUP "]\n");
-        if( logout_cmd )
-            fprintf( f, "Logout=%s\n", logout_cmd );
-        fclose( f );
-    }
-    g_free(file);
+    GString *str = g_string_new("[" COMMAND_GROUP "]\n");
+    gsize len;
+
+    if( logout_cmd )
+        g_string_append_printf(str, "Logout=%s\n", logout_cmd);
+    if (config_save_delay != CONFIG_SAVE_DELAY || lxpanel_defer_plugins ||
+        lxpanel_export_metrics || lxpanel_config_cache)
+        g_string_append(str, "[" CONFIG_GROUP "]\n");
+    if (config_save_delay != CONFIG_SAVE_DELAY)
+        g_string_append_printf(str, "SaveDelay=%u\n", config_save_delay);
+    if (lxpanel_defer_plugins)
+        g_string_append(str, "DeferPlugins=true\n");
+    if (lxpanel_export_metrics)
+        g_string_append(str, "ExportMetrics=true\n");
+    if (lxpanel_config_cache)
+        g_string_append(str, "CacheConfig=true\n");
+    len = str->len;
+    config_save_queue(_user_config_file_name("config", NULL),
+                      g_string_free(str, FALSE), len, g_free);
 }
 
 void free_global_config()
@@ -30,6 +30,7 @@
 #include <gdk/gdkx.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
+#include <string.h>
 
 #include "ev.h"
 #include "misc.h"
@@ -59,6 +60,12 @@ struct _FbEv {
     Window *client_list;
     Window *client_list_stacking;
 
+    guint    pending;       /* mask of signals queued for emission */
+    guchar   order[LAST_SIGNAL]; /* queued signals in order of arrival */
+    guint    n_pending;     /* number of signals in order */
+    guint    flush_idle;    /* idle source which emits pending signals */
+    guint    merged;        /* number of queued signals merged into pending */
+
     Window   xroot;
     Atom     id;
     GC       gc;
@@ -201,9 +208,11 @@ fb_ev_new()
 static void
 fb_ev_finalize (GObject *object)
 {
-    //FbEv *ev;
+    FbEv *ev;
 
-    //ev = FB_EV (object);
+    ev = FB_EV (object);
+    if (ev->flush_idle)
+        g_source_remove(ev->flush_idle);
     //XFreeGC(ev->dpy, ev->gc);
 }
 
@@ -227,6 +236,73 @@ fb_ev_emit(FbEv *ev, int signal)
     g_signal_emit(ev, signals [signal], 0);
 }
 
+static gboolean
+fb_ev_flush(gpointer user_data)
+{
+    FbEv *ev = user_data;
+    int signal;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    ev->flush_idle = 0;
+    /* signals are emitted in order of arrival, so EV_ACTIVE_WINDOW for a
+       window which was just mapped comes after EV_CLIENT_LIST which adds
+       it; handlers may queue new signals, they are appended to the queue */
+    while (ev->n_pending > 0)
+    {
+        signal = ev->order[0];
+        ev->n_pending--;
+        memmove(ev->order, ev->order + 1, ev->n_pending);
+        ev->pending &= ~(1 << signal);
+        fb_ev_emit(ev, signal);
+    }
+    return FALSE;
+}
+
+/**
+ * fb_ev_queue
+ * @ev: the events listener
+ * @signal: signal to emit
+ *
+ * Queues @signal to be emitted once the main loop goes idle, before the
+ * panel is redrawn. Signals are emitted in the order they were queued; the
+ * same signal queued several times before that is emitted only once, in the
+ * place it was first queued. Signals that carry data such as EV_DESTROY_WINDOW
+ * cannot be queued and should be emitted with fb_ev_emit_destroy().
+ */
+void
+fb_ev_queue(FbEv *ev, int signal)
+{
+    g_return_if_fail(signal >= 0 && signal < LAST_SIGNAL && signal != EV_DESTROY_WINDOW);
+
+    if (ev->pending & (1 << signal))
+    {
+        ev->merged++;
+        return;
+    }
+    ev->pending |= (1 << signal);
+    ev->order[ev->n_pending++] = signal;
+    if (ev->flush_idle == 0)
+        /* GTK+ redraws at G_PRIORITY_HIGH_IDLE + 20, do the job before it */
+        ev->flush_idle = g_idle_add_full(G_PRIORITY_HIGH_IDLE, fb_ev_flush,
+                                         ev, NULL);
+}
+
+/**
+ * fb_ev_get_merged_count
+ * @ev: the events listener
+ *
+ * Retrieves how many signals queued by fb_ev_queue() were merged into an
+ * already pending one instead of being emitted again.
+ *
+ * Returns: number of merged signals since @ev was created.
+ */
+guint
+fb_ev_get_merged_count(FbEv *ev)
+{
+    return ev->merged;
+}
+
 void fb_ev_emit_destroy(FbEv *ev, Window win)
 {
     g_signal_emit(ev, signals [EV_DESTROY_WINDOW], 0, win );
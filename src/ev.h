@@ -69,6 +69,8 @@ GType fb_ev_get_type       (void);
 FbEv *fb_ev_new(void);
 void fb_ev_notify_changed_ev(FbEv *ev);
 void fb_ev_emit(FbEv *ev, int signal);
+void fb_ev_queue(FbEv *ev, int signal);
+guint fb_ev_get_merged_count(FbEv *ev);
 void fb_ev_emit_destroy(FbEv *ev, Window win);
 
 extern int fb_ev_current_desktop(FbEv *ev);
@@ -0,0 +1,107 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Adds samples to a PluginGraph and paints it as the panel would, at
+   several icon sizes and so graph widths, and prints the time per sample.
+   It uses only the PluginGraph API, so the same file builds against older
+   trees as well; to compare with the renderer which redrew the whole
+   history on every sample, build it against the tree before the surface
+   was made circular and run both.
+   Needs a display; exits with 77 (skipped) if there is none.
+
+   Usage: graph-bench [samples] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "plugin.h"
+
+static const int icon_sizes[] = { 16, 36, 64, 128, 256 };
+
+static gint64 run(PluginGraph *graph, cairo_t *cr, guint samples)
+{
+    char label[8];
+    gint64 time;
+    guint i;
+
+    time = g_get_monotonic_time();
+    for (i = 0; i < samples; i++)
+    {
+        snprintf(label, sizeof(label), "%u%%", i % 100);
+        graph_new_point(graph, (i % 100) / 100.0, i % 3 ? 0 : 1, label);
+        gtk_widget_draw(graph->da, cr);
+    }
+    return g_get_monotonic_time() - time;
+}
+
+int main(int argc, char **argv)
+{
+    guint samples = argc > 1 ? atoi(argv[1]) : 2000;
+    GdkRGBA colours[4];
+    GtkWidget *window;
+    PluginGraph graph;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    gint64 time;
+    guint i;
+
+    if (!gtk_init_check(&argc, &argv))
+    {
+        fprintf(stderr, "%s: cannot open display, skipped\n", argv[0]);
+        return 77;
+    }
+    if (samples == 0)
+    {
+        fprintf(stderr, "usage: %s [samples]\n", argv[0]);
+        return 2;
+    }
+    gdk_rgba_parse(&colours[0], "#202020");
+    gdk_rgba_parse(&colours[1], "#40a040");
+    gdk_rgba_parse(&colours[2], "#e0c020");
+    gdk_rgba_parse(&colours[3], "#e02020");
+
+    printf("%u samples\n", samples);
+    for (i = 0; i < G_N_ELEMENTS(icon_sizes); i++)
+    {
+        window = gtk_offscreen_window_new();
+        graph_init(&graph);
+        gtk_container_add(GTK_CONTAINER(window), graph.da);
+        graph_reload(&graph, icon_sizes[i], colours[0], colours[1],
+                     colours[2], colours[3]);
+        gtk_widget_show_all(window);
+        while (gtk_events_pending())
+            gtk_main_iteration();
+
+        surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                             gtk_widget_get_allocated_width(graph.da),
+                                             gtk_widget_get_allocated_height(graph.da));
+        cr = cairo_create(surface);
+        /* fill the history once so both halves of the ring are drawn */
+        run(&graph, cr, graph.pixmap_width);
+        time = run(&graph, cr, samples);
+        printf("  width %3u: %8.2f us/sample\n", graph.pixmap_width,
+               (double)time / samples);
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+
+        /* graph_free() destroys the drawing area */
+        graph_free(&graph);
+        gtk_widget_destroy(window);
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "graph-history.h"
+
+#include <string.h>
+
+#define HISTORY_TIME_UNIT   100000      /* us, times are stored in 1/10 s */
+#define HISTORY_RAW_SIZE    600         /* ten minutes at one sample per second */
+#define HISTORY_LEVELS      2
+#define HISTORY_VALUE_MAX   65535
+
+/* length of rollup buckets in time units, and number of buckets kept */
+static const guint32 history_bucket_len[HISTORY_LEVELS] = { 100, 1200 };
+static const guint history_level_size[HISTORY_LEVELS] = { 360, 360 };
+
+typedef struct {
+    guint32 time;
+    guint16 value;
+    guint16 state;
+} HistoryRaw;
+
+typedef struct {
+    guint32 time;               /* start of the bucket */
+    guint16 min, max, avg;
+    guint16 state;              /* highest state in the bucket */
+} HistoryRollup;
+
+typedef struct {
+    HistoryRollup *ring;
+    guint head;                 /* where the next bucket goes */
+    guint count;
+    /* bucket being filled */
+    guint32 bucket;
+    guint n;
+    guint32 sum;
+    guint16 min, max, state;
+} HistoryLevel;
+
+struct _GraphHistory {
+    gint64 start;               /* monotonic time of time unit 0 */
+    HistoryRaw *raw;
+    guint raw_head;
+    guint raw_count;
+    HistoryLevel levels[HISTORY_LEVELS];
+};
+
+GraphHistory *graph_history_new(void)
+{
+    GraphHistory *h;
+    gsize size;
+    char *p;
+    guint l;
+
+    /* history, raw ring and rollup rings are a single block */
+    size = sizeof(GraphHistory) + HISTORY_RAW_SIZE * sizeof(HistoryRaw);
+    for (l = 0; l < HISTORY_LEVELS; l++)
+        size += history_level_size[l] * sizeof(HistoryRollup);
+    h = g_malloc0(size);
+    p = (char *)(h + 1);
+    h->raw = (HistoryRaw *)p;
+    p += HISTORY_RAW_SIZE * sizeof(HistoryRaw);
+    for (l = 0; l < HISTORY_LEVELS; l++)
+    {
+        h->levels[l].ring = (HistoryRollup *)p;
+        p += history_level_size[l] * sizeof(HistoryRollup);
+    }
+    h->start = g_get_monotonic_time();
+    return h;
+}
+
+void graph_history_free(GraphHistory *h)
+{
+    g_free(h);
+}
+
+static void _history_level_close(HistoryLevel *lv, guint l)
+{
+    HistoryRollup *r = &lv->ring[lv->head];
+
+    r->time = lv->bucket * history_bucket_len[l];
+    r->min = lv->min;
+    r->max = lv->max;
+    r->avg = lv->sum / lv->n;
+    r->state = lv->state;
+    if (++lv->head == history_level_size[l])
+        lv->head = 0;
+    if (lv->count < history_level_size[l])
+        lv->count++;
+    lv->n = 0;
+}
+
+void graph_history_add(GraphHistory *h, gint64 now, float value, int state)
+{
+    HistoryRaw *r;
+    HistoryLevel *lv;
+    guint32 time, bucket;
+    guint16 v;
+    guint l;
+
+    time = (now - h->start) / HISTORY_TIME_UNIT;
+    v = CLAMP(value, 0.0, 1.0) * HISTORY_VALUE_MAX + 0.5;
+
+    r = &h->raw[h->raw_head];
+    r->time = time;
+    r->value = v;
+    r->state = state;
+    if (++h->raw_head == HISTORY_RAW_SIZE)
+        h->raw_head = 0;
+    if (h->raw_count < HISTORY_RAW_SIZE)
+        h->raw_count++;
+
+    for (l = 0; l < HISTORY_LEVELS; l++)
+    {
+        lv = &h->levels[l];
+        bucket = time / history_bucket_len[l];
+        if (lv->n > 0 && bucket != lv->bucket)
+            _history_level_close(lv, l);
+        if (lv->n == 0)
+        {
+            lv->bucket = bucket;
+            lv->sum = 0;
+            lv->min = v;
+            lv->max = v;
+            lv->state = state;
+        }
+        lv->n++;
+        lv->sum += v;
+        lv->min = MIN(lv->min, v);
+        lv->max = MAX(lv->max, v);
+        lv->state = MAX(lv->state, (guint16)state);
+    }
+}
+
+gint64 graph_history_interval(GraphHistory *h)
+{
+    guint newest, oldest;
+
+    if (h->raw_count < 2)
+        return 0;
+    newest = (h->raw_head + HISTORY_RAW_SIZE - 1) % HISTORY_RAW_SIZE;
+    oldest = (h->raw_head + HISTORY_RAW_SIZE - h->raw_count) % HISTORY_RAW_SIZE;
+    return (gint64)(h->raw[newest].time - h->raw[oldest].time) * HISTORY_TIME_UNIT /
+           (h->raw_count - 1);
+}
+
+/* Accumulates one entry into its column. Entries come in time order, so the
+   column is written out when the next one starts. */
+typedef struct {
+    float *avg, *max;
+    int *states;
+    guint n;
+    gint64 first;               /* time of column 0, in time units */
+    gint64 span;                /* in time units */
+    gint column;                /* column being accumulated or -1 */
+    gint last;                  /* last column written by coarser level */
+    gint skip;                  /* column to leave to coarser level */
+    guint count;
+    guint32 sum;
+    guint16 max_value, state;
+} HistoryResample;
+
+static void _resample_flush(HistoryResample *rs)
+{
+    if (rs->column < 0)
+        return;
+    rs->avg[rs->column] = (float)rs->sum / rs->count / HISTORY_VALUE_MAX;
+    if (rs->max)
+        rs->max[rs->column] = (float)rs->max_value / HISTORY_VALUE_MAX;
+    rs->states[rs->column] = rs->state;
+    rs->last = MAX(rs->last, rs->column);
+    rs->column = -1;
+}
+
+static gint _resample_column(HistoryResample *rs, gint64 time)
+{
+    gint64 c;
+
+    if (time < rs->first)
+        return -1;
+    c = (time - rs->first) * rs->n / rs->span;
+    return c < rs->n ? c : -1;
+}
+
+/* The oldest entry of a finer level usually covers only a part of its
+   column, so the column is left to a coarser level if it has data there. */
+static void _resample_start_level(HistoryResample *rs, gint64 start)
+{
+    gint c = _resample_column(rs, start);
+
+    rs->skip = (c >= 0 && c <= rs->last) ? c : -1;
+}
+
+static void _resample_add(HistoryResample *rs, gint64 time, guint16 avg,
+                          guint16 max, guint16 state)
+{
+    gint c = _resample_column(rs, time);
+
+    if (c < 0 || c == rs->skip)
+        return;
+    if (c != rs->column)
+    {
+        _resample_flush(rs);
+        rs->column = c;
+        rs->count = 0;
+        rs->sum = 0;
+        rs->max_value = 0;
+        rs->state = 0;
+    }
+    rs->count++;
+    rs->sum += avg;
+    rs->max_value = MAX(rs->max_value, max);
+    rs->state = MAX(rs->state, state);
+}
+
+void graph_history_resample(GraphHistory *h, gint64 end, gint64 span, guint n,
+                            float *avg, float *max, int *states)
+{
+    HistoryResample rs;
+    HistoryLevel *lv;
+    HistoryRollup *r;
+    HistoryRaw *raw;
+    guint i, l;
+
+    memset(avg, 0, n * sizeof(float));
+    if (max)
+        memset(max, 0, n * sizeof(float));
+    memset(states, 0, n * sizeof(int));
+
+    rs.avg = avg;
+    rs.max = max;
+    rs.states = states;
+    rs.n = n;
+    rs.span = MAX(span / HISTORY_TIME_UNIT, 1);
+    rs.first = (end - h->start) / HISTORY_TIME_UNIT - rs.span;
+    rs.column = -1;
+    rs.last = -1;
+
+    /* coarsest first, so finer data overwrites columns it covers */
+    for (l = HISTORY_LEVELS; l-- > 0; )
+    {
+        lv = &h->levels[l];
+        if (lv->count == 0)
+            continue;
+        r = &lv->ring[(lv->head + history_level_size[l] - lv->count) % history_level_size[l]];
+        _resample_start_level(&rs, r->time);
+        for (i = lv->count; i > 0; i--)
+        {
+            r = &lv->ring[(lv->head + history_level_size[l] - i) % history_level_size[l]];
+            _resample_add(&rs, r->time + history_bucket_len[l] / 2,
+                          r->avg, r->max, r->state);
+        }
+        _resample_flush(&rs);
+    }
+    if (h->raw_count > 0)
+        _resample_start_level(&rs, h->raw[(h->raw_head + HISTORY_RAW_SIZE - h->raw_count) % HISTORY_RAW_SIZE].time);
+    for (i = h->raw_count; i > 0; i--)
+    {
+        raw = &h->raw[(h->raw_head + HISTORY_RAW_SIZE - i) % HISTORY_RAW_SIZE];
+        _resample_add(&rs, raw->time, raw->value, raw->value, raw->state);
+    }
+    _resample_flush(&rs);
+}
+
+guint graph_history_recent(GraphHistory *h, guint n, float *values, int *states)
+{
+    HistoryRaw *raw;
+    guint i, count = MIN(n, h->raw_count);
+
+    for (i = 0; i < count; i++)
+    {
+        raw = &h->raw[(h->raw_head + HISTORY_RAW_SIZE - count + i) % HISTORY_RAW_SIZE];
+        values[n - count + i] = (float)raw->value / HISTORY_VALUE_MAX;
+        states[n - count + i] = raw->state;
+    }
+    return count;
+}
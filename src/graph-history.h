@@ -0,0 +1,54 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GRAPH_HISTORY_H__
+#define __GRAPH_HISTORY_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Multi-resolution store of graph values. Raw samples are kept for about
+   ten minutes, and min/max/average rollups of 10 seconds for an hour and
+   of 2 minutes for twelve hours. All of it lives in a single block of
+   fixed size allocated once, so adding a sample never allocates. */
+
+typedef struct _GraphHistory GraphHistory;
+
+GraphHistory *graph_history_new(void);
+void graph_history_free(GraphHistory *h);
+
+/* adds sample value (0.0 ... 1.0) with state, taken at monotonic time now */
+void graph_history_add(GraphHistory *h, gint64 now, float value, int state);
+
+/* returns average interval between raw samples in microseconds, or 0 */
+gint64 graph_history_interval(GraphHistory *h);
+
+/* fills n columns covering span microseconds before end with average and
+   maximum (max may be NULL) and highest state of samples in each column,
+   using the finest resolution available for each; empty columns are 0 */
+void graph_history_resample(GraphHistory *h, gint64 end, gint64 span, guint n,
+                            float *avg, float *max, int *states);
+
+/* copies up to n newest raw samples to the end of values and states,
+   returns number of samples copied */
+guint graph_history_recent(GraphHistory *h, guint n, float *values, int *states);
+
+G_END_DECLS
+
+#endif /* __GRAPH_HISTORY_H__ */
@@ -0,0 +1,129 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Lays out a PanelIconGrid with many children in an offscreen window and
+   counts how many children get allocated, and how long it takes, when the
+   grid is allocated again unchanged, when one child queues a resize that
+   doesn't change its size, and when a child is added and removed. It
+   uses only the public API so it can be run against older trees as well.
+   Needs a display; exits with 77 (skipped) if there is none.
+
+   Usage: icon-grid-bench [children] [rounds] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "icon-grid.h"
+
+#define CHILD_SIZE 24
+
+static guint n_allocated;
+
+static void on_child_size_allocate(GtkWidget *child, GtkAllocation *alloc,
+                                   gpointer unused)
+{
+    n_allocated++;
+}
+
+static GtkWidget *add_child(GtkWidget *grid)
+{
+    GtkWidget *child = gtk_event_box_new();
+
+    gtk_widget_set_size_request(child, CHILD_SIZE, CHILD_SIZE);
+    g_signal_connect(child, "size-allocate",
+                     G_CALLBACK(on_child_size_allocate), NULL);
+    gtk_container_add(GTK_CONTAINER(grid), child);
+    gtk_widget_show(child);
+    return child;
+}
+
+static void flush(void)
+{
+    while (gtk_events_pending())
+        gtk_main_iteration();
+}
+
+static void report(const char *what, guint rounds, gint64 time)
+{
+    printf("  %-16s %8.2f us/round %8.2f children allocated/round\n", what,
+           (double)time / rounds, (double)n_allocated / rounds);
+}
+
+int main(int argc, char **argv)
+{
+    guint children = argc > 1 ? atoi(argv[1]) : 200;
+    guint rounds = argc > 2 ? atoi(argv[2]) : 1000;
+    GtkWidget *window, *grid, *child = NULL, *extra;
+    GtkAllocation alloc;
+    gint64 time;
+    guint i;
+
+    if (!gtk_init_check(&argc, &argv))
+    {
+        fprintf(stderr, "%s: cannot open display, skipped\n", argv[0]);
+        return 77;
+    }
+    if (children == 0 || rounds == 0)
+    {
+        fprintf(stderr, "usage: %s [children] [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    window = gtk_offscreen_window_new();
+    /* two rows of icons, as in a taskbar of a panel 60 pixels high */
+    grid = panel_icon_grid_new(GTK_ORIENTATION_HORIZONTAL, CHILD_SIZE,
+                               CHILD_SIZE, 3, 0, 2 * CHILD_SIZE + 3);
+    gtk_container_add(GTK_CONTAINER(window), grid);
+    for (i = 0; i < children; i++)
+        child = add_child(grid);
+    gtk_widget_show_all(window);
+    flush();
+    gtk_widget_get_allocation(grid, &alloc);
+    printf("%u children, %dx%d grid, %u rounds\n", children, alloc.width,
+           alloc.height, rounds);
+
+    n_allocated = 0;
+    time = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++)
+        gtk_widget_size_allocate(grid, &alloc);
+    report("unchanged:", rounds, g_get_monotonic_time() - time);
+
+    /* as a task button does when its label changes */
+    n_allocated = 0;
+    time = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++)
+    {
+        gtk_widget_queue_resize(child);
+        flush();
+    }
+    report("one resized:", rounds, g_get_monotonic_time() - time);
+
+    n_allocated = 0;
+    time = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++)
+    {
+        extra = add_child(grid);
+        flush();
+        gtk_widget_destroy(extra);
+        flush();
+    }
+    report("add and remove:", rounds, g_get_monotonic_time() - time);
+
+    gtk_widget_destroy(window);
+    return 0;
+}
@@ -43,11 +43,31 @@ enum {
   CHILD_PROP_POSITION
 };
 
+/* Cached placement of a visible child from the last layout pass. */
+typedef struct
+{
+    GtkWidget *child;
+    GtkRequisition req;				/* Checked requisition of the child */
+    GtkAllocation allocation;			/* Allocation given to the child */
+    guint x, y;					/* Placement state after the child, */
+    int x_delta;				/* so layout can be resumed from the */
+    guint next_coord;				/* next one */
+} IconGridLayoutItem;
+
+/* Cached extent of a row (in vertical orientation) or a column (in
+   horizontal orientation) from the last layout pass. */
+typedef struct
+{
+    guint first;				/* Index of first item in layout */
+    gint start, end;				/* Extent along the wrapping direction */
+} IconGridLayoutLine;
+
 /* Representative of an icon grid.  This is a manager that packs widgets into a rectangular grid whose size adapts to conditions. */
 struct _PanelIconGrid
 {
     GtkContainer container;			/* Parent widget */
-    GList * children;				/* List of icon grid elements */
+    GPtrArray * children;			/* Array of icon grid elements */
+    GHashTable * child_index;			/* Element to its position (plus one) */
     GtkOrientation orientation;			/* Desired orientation */
     gint child_width;				/* Desired child width */
     gint child_height;				/* Desired child height */
@@ -62,6 +82,18 @@ struct _PanelIconGrid
     GtkWidget *dest_item;			/* Drag destination to draw focus */
     PanelIconGridDropPosition dest_pos;		/* Position to draw focus */
     gboolean hide_children;         /* Flag to force a full redraw of all children while keeping overall allocation the same */
+    IconGridLayoutItem *layout;			/* Visible children placement from last layout */
+    guint n_layout;				/* Number of items in layout */
+    guint layout_size;				/* Allocated size of layout */
+    gboolean layout_valid;			/* False if layout should be computed again */
+    guint layout_dirty;				/* Index of first child changed since last layout */
+    GtkAllocation layout_allocation;		/* Allocation used for layout */
+    gint layout_child_width;			/* Child width used for layout */
+    gint layout_child_height;			/* Child height used for layout */
+    GtkTextDirection layout_direction;		/* Text direction used for layout */
+    IconGridLayoutLine *lines;			/* Rows or columns from last layout */
+    guint n_lines;				/* Number of lines in layout */
+    guint lines_size;				/* Allocated size of lines */
 };
 
 struct _PanelIconGridClass
@@ -89,6 +121,89 @@ static void icon_grid_element_check_requisition(PanelIconGrid *ig,
 static void panel_icon_grid_size_request(GtkWidget *widget,
                                          GtkRequisition *requisition);
 
+/* Mark the whole layout to be computed again on next allocation. */
+static inline void panel_icon_grid_invalidate_layout(PanelIconGrid *ig)
+{
+    ig->layout_valid = FALSE;
+}
+
+/* Mark the layout to be computed again from the child at index i on. */
+static inline void panel_icon_grid_invalidate_from(PanelIconGrid *ig, guint i)
+{
+    ig->layout_dirty = MIN(ig->layout_dirty, i);
+}
+
+static void panel_icon_grid_child_visible_changed(GtkWidget *child,
+                                                  GParamSpec *pspec,
+                                                  PanelIconGrid *ig)
+{
+    guint position = GPOINTER_TO_UINT(g_hash_table_lookup(ig->child_index, child));
+
+    if (position > 0)
+        panel_icon_grid_invalidate_from(ig, position - 1);
+}
+
+/* Find how much of the last layout is still valid. Returns number of items
+   which keep their cells, and index of the child to continue layout from in
+   first_child. Extents of the line the layout continues in are recomputed. */
+static guint panel_icon_grid_layout_start(PanelIconGrid *ig,
+                                          GtkAllocation *allocation,
+                                          int child_width, int child_height,
+                                          GtkTextDirection direction,
+                                          guint *first_child)
+{
+    IconGridLayoutLine *line;
+    GtkAllocation *a;
+    GtkWidget *child;
+    guint i, n = 0;
+
+    *first_child = 0;
+    if (!ig->layout_valid || ig->hide_children
+        || ig->layout_child_width != child_width
+        || ig->layout_child_height != child_height
+        || ig->layout_direction != direction
+        || memcmp(&ig->layout_allocation, allocation, sizeof(GtkAllocation)) != 0)
+    {
+        ig->n_lines = 0;
+        return 0;
+    }
+    for (i = 0; i < ig->children->len && i < ig->layout_dirty; i++)
+    {
+        child = g_ptr_array_index(ig->children, i);
+        if (gtk_widget_get_visible(child))
+        {
+            if (n >= ig->n_layout || ig->layout[n].child != child)
+                break;
+            n++;
+        }
+    }
+
+    while (ig->n_lines > 0 && ig->lines[ig->n_lines - 1].first >= n)
+        ig->n_lines--;
+    if (ig->n_lines == 0) /* nothing to continue */
+        return 0;
+    *first_child = i;
+
+    line = &ig->lines[ig->n_lines - 1];
+    line->start = G_MAXINT;
+    line->end = G_MININT;
+    for (i = line->first; i < n; i++)
+    {
+        a = &ig->layout[i].allocation;
+        if (ig->orientation == GTK_ORIENTATION_HORIZONTAL)
+        {
+            line->start = MIN(line->start, a->x);
+            line->end = MAX(line->end, a->x + a->width);
+        }
+        else
+        {
+            line->start = MIN(line->start, a->y);
+            line->end = MAX(line->end, a->y + a->height);
+        }
+    }
+    return n;
+}
+
 static gboolean check_for_recalc(PanelIconGrid *ig)
 {
     GtkWidget *toplevel = gtk_widget_get_toplevel((GtkWidget *)ig);
@@ -121,8 +236,11 @@ static void panel_icon_grid_size_allocate(GtkWidget *widget,
     int x_delta;
     guint next_coord;
     guint x, y;
-    GList *ige;
+    guint i, n, n_old;
+    gboolean new_line, moved;
+    gint start, end;
     GtkWidget *child;
+    IconGridLayoutItem *item;
 
     /* Apply given allocation */
     gtk_widget_set_allocation(widget, allocation);
@@ -194,19 +312,44 @@ static void panel_icon_grid_size_allocate(GtkWidget *widget,
             child_height = MAX(2, x_delta);
     }
 
-    /* Initialize parameters to control repositioning each visible child. */
+    /* Children before the first one changed since last layout keep their
+       cells, continue the layout from there. */
     direction = gtk_widget_get_direction(widget);
-    x = (direction == GTK_TEXT_DIR_RTL) ? allocation->width - x_border : x_border;
-    y = y_border;
-    x_delta = 0;
-    next_coord = border;
+    n_old = ig->n_layout;
+    ig->n_layout = panel_icon_grid_layout_start(ig, allocation, child_width,
+                                                child_height, direction, &i);
+#if !GTK_CHECK_VERSION(3, 20, 0)
+    /* GTK+ before 3.20 doesn't allocate by itself children which queued
+       resize, give them their cells again; it skips others */
+    for (n = 0; n < ig->n_layout; n++)
+        gtk_widget_size_allocate(ig->layout[n].child, &ig->layout[n].allocation);
+#endif
+
+    /* Initialize parameters to control repositioning each visible child. */
+    if (ig->n_layout > 0)
+    {
+        item = &ig->layout[ig->n_layout - 1];
+        x = item->x;
+        y = item->y;
+        x_delta = item->x_delta;
+        next_coord = item->next_coord;
+    }
+    else
+    {
+        x = (direction == GTK_TEXT_DIR_RTL) ? allocation->width - x_border : x_border;
+        y = y_border;
+        x_delta = 0;
+        next_coord = border;
+    }
 
     /* Reposition each visible child. */
-    for (ige = ig->children; ige != NULL; ige = ige->next)
+    for (; i < ig->children->len; i++)
     {
-        child = ige->data;
+        child = g_ptr_array_index(ig->children, i);
         if (gtk_widget_get_visible(child))
         {
+            new_line = (ig->n_layout == 0);
+
             /* Do necessary operations on the child. */
 #if GTK_CHECK_VERSION(3, 0, 0)
             gtk_widget_get_preferred_size (child, NULL, &req);
@@ -234,6 +377,7 @@ static void panel_icon_grid_size_allocate(GtkWidget *widget,
                     else
                         x += (x_delta + ig->spacing);
                     x_delta = 0;
+                    new_line = TRUE;
                     // FIXME: if fill_width and rows = 1 then allocate whole column
                 }
                 next_coord = y + child_height + ig->spacing;
@@ -249,6 +393,7 @@ static void panel_icon_grid_size_allocate(GtkWidget *widget,
                     {
                         x = allocation->width - x_border;
                         y += child_height + ig->spacing;
+                        new_line = TRUE;
                     }
                     next_coord = x - child_allocation.width - ig->spacing;
                 }
@@ -258,6 +403,7 @@ static void panel_icon_grid_size_allocate(GtkWidget *widget,
                     {
                         x = x_border;
                         y += child_height + ig->spacing;
+                        new_line = TRUE;
                     }
                     next_coord = x + child_allocation.width + ig->spacing;
                 }
@@ -276,21 +422,94 @@ static void panel_icon_grid_size_allocate(GtkWidget *widget,
                 child_allocation.y += allocation->y;
             }
             // FIXME: if fill_width and rows > 1 then delay allocation
-            gtk_widget_size_allocate(child, &child_allocation);
+            /* Only children whose cell changed need to be allocated, GTK+
+               takes care of those which queued resize. */
+            moved = ig->hide_children || ig->n_layout >= n_old
+                    || ig->layout[ig->n_layout].child != child
+                    || memcmp(&ig->layout[ig->n_layout].allocation,
+                              &child_allocation, sizeof(GtkAllocation)) != 0;
+#if GTK_CHECK_VERSION(3, 20, 0)
+            if (moved)
+#endif
+                gtk_widget_size_allocate(child, &child_allocation);
+
+            /* Remember it for the next pass. */
+            if (ig->n_layout == ig->layout_size)
+            {
+                ig->layout_size = MAX(16, ig->layout_size * 2);
+                ig->layout = g_renew(IconGridLayoutItem, ig->layout, ig->layout_size);
+            }
+            item = &ig->layout[ig->n_layout];
+            item->child = child;
+            item->req = req;
+            item->allocation = child_allocation;
+            item->x = x;
+            item->y = y;
+            item->x_delta = x_delta;
+            item->next_coord = next_coord;
+
+            /* Track extents of rows or columns for hit testing. */
+            if (ig->orientation == GTK_ORIENTATION_HORIZONTAL)
+            {
+                start = child_allocation.x;
+                end = child_allocation.x + child_allocation.width;
+            }
+            else
+            {
+                start = child_allocation.y;
+                end = child_allocation.y + child_allocation.height;
+            }
+            if (new_line)
+            {
+                if (ig->n_lines == ig->lines_size)
+                {
+                    ig->lines_size = MAX(8, ig->lines_size * 2);
+                    ig->lines = g_renew(IconGridLayoutLine, ig->lines, ig->lines_size);
+                }
+                ig->lines[ig->n_lines].first = ig->n_layout;
+                ig->lines[ig->n_lines].start = start;
+                ig->lines[ig->n_lines].end = end;
+                ig->n_lines++;
+            }
+            else
+            {
+                ig->lines[ig->n_lines - 1].start = MIN(ig->lines[ig->n_lines - 1].start, start);
+                ig->lines[ig->n_lines - 1].end = MAX(ig->lines[ig->n_lines - 1].end, end);
+            }
+            ig->n_layout++;
         }
     }
+    ig->layout_allocation = *allocation;
+    ig->layout_child_width = child_width;
+    ig->layout_child_height = child_height;
+    ig->layout_direction = direction;
+    ig->layout_valid = !ig->hide_children;
+    ig->layout_dirty = G_MAXUINT;
+}
+
+/* Invalidate layout from child at index i if it was changed since last
+   layout, n is its index in layout. */
+static inline void panel_icon_grid_check_layout_item(PanelIconGrid *ig, guint n,
+                                                     guint i, GtkWidget *child,
+                                                     GtkRequisition *req)
+{
+    if (n >= ig->n_layout || ig->layout[n].child != child ||
+        ig->layout[n].req.width != req->width ||
+        ig->layout[n].req.height != req->height)
+        panel_icon_grid_invalidate_from(ig, i);
 }
 
 /* Establish the geometry of an icon grid. */
 static void panel_icon_grid_calculate_size(PanelIconGrid *ig,
                                            GtkRequisition *requisition)
 {
-    GList *ige;
+    GtkWidget *child;
     int target_dimension = MAX(ig->target_dimension, 0);
     guint border = gtk_container_get_border_width(GTK_CONTAINER(ig));
     guint target_borders = MAX(2 * border, ig->spacing);
     gint row = 0, w = 0;
     GtkRequisition child_requisition;
+    guint i, n = 0;
 
     requisition->width = 0;
     requisition->height = 0;
@@ -305,15 +524,18 @@ static void panel_icon_grid_calculate_size(PanelIconGrid *ig,
         if (ig->rows == 0)
             ig->rows = 1;
         /* Count visible children and columns. */
-        for (ige = ig->children; ige != NULL; ige = ige->next)
-            if (gtk_widget_get_visible(ige->data))
+        for (i = 0; i < ig->children->len; i++)
+        {
+            child = g_ptr_array_index(ig->children, i);
+            if (gtk_widget_get_visible(child))
             {
 #if GTK_CHECK_VERSION(3, 0, 0)
-                gtk_widget_get_preferred_size(ige->data, NULL, &child_requisition);
+                gtk_widget_get_preferred_size(child, NULL, &child_requisition);
 #else
-                gtk_widget_size_request(ige->data, &child_requisition);
+                gtk_widget_size_request(child, &child_requisition);
 #endif
                 icon_grid_element_check_requisition(ig, &child_requisition);
+                panel_icon_grid_check_layout_item(ig, n++, i, child, &child_requisition);
                 if (row == 0)
                     ig->columns++;
                 w = MAX(w, child_requisition.width);
@@ -326,6 +548,7 @@ static void panel_icon_grid_calculate_size(PanelIconGrid *ig,
                     row = w = 0;
                 }
             }
+        }
         if (w > 0)
         {
             if (requisition->width > 0)
@@ -356,15 +579,18 @@ static void panel_icon_grid_calculate_size(PanelIconGrid *ig,
         if (ig->columns == 0)
             ig->columns = 1;
         /* Count visible children and rows. */
-        for (ige = ig->children; ige != NULL; ige = ige->next)
-            if (gtk_widget_get_visible(ige->data))
+        for (i = 0; i < ig->children->len; i++)
+        {
+            child = g_ptr_array_index(ig->children, i);
+            if (gtk_widget_get_visible(child))
             {
 #if GTK_CHECK_VERSION(3, 0, 0)
-                gtk_widget_get_preferred_size(ige->data, NULL, &child_requisition);
+                gtk_widget_get_preferred_size(child, NULL, &child_requisition);
 #else
-                gtk_widget_size_request(ige->data, &child_requisition);
+                gtk_widget_size_request(child, &child_requisition);
 #endif
                 icon_grid_element_check_requisition(ig, &child_requisition);
+                panel_icon_grid_check_layout_item(ig, n++, i, child, &child_requisition);
                 if (w > 0)
                 {
                     w += ig->spacing;
@@ -377,6 +603,7 @@ static void panel_icon_grid_calculate_size(PanelIconGrid *ig,
                 w += child_requisition.width;
                 requisition->width = MAX(requisition->width, w);
             }
+        }
         if (w > 0)
             ig->rows++;
         if (requisition->width > 0)
@@ -441,10 +668,15 @@ static void panel_icon_grid_add(GtkContainer *container, GtkWidget *widget)
     PanelIconGrid *ig = PANEL_ICON_GRID(container);
 
     /* Insert at the tail of the child list.  This keeps the graphics in the order they were added. */
-    ig->children = g_list_append(ig->children, widget);
+    g_ptr_array_add(ig->children, widget);
+    g_hash_table_insert(ig->child_index, widget,
+                        GUINT_TO_POINTER(ig->children->len));
 
     /* Add the widget to the layout container. */
     gtk_widget_set_parent(widget, GTK_WIDGET(container));
+    g_signal_connect(widget, "notify::visible",
+                     G_CALLBACK(panel_icon_grid_child_visible_changed), ig);
+    panel_icon_grid_invalidate_from(ig, ig->children->len - 1);
 //    gtk_widget_queue_resize(GTK_WIDGET(container));
 }
 
@@ -457,6 +689,7 @@ void panel_icon_grid_set_constrain_width(PanelIconGrid * ig, gboolean constrain_
         return;
 
     ig->constrain_width = !!constrain_width;
+    panel_icon_grid_invalidate_layout(ig);
     gtk_widget_queue_resize(GTK_WIDGET(ig));
 }
 
@@ -468,6 +701,7 @@ void panel_icon_grid_set_aspect_width(PanelIconGrid * ig, gboolean aspect_width)
         return;
 
     ig->aspect_width = !!aspect_width;
+    panel_icon_grid_invalidate_layout(ig);
     gtk_widget_queue_resize(GTK_WIDGET(ig));
 }
 
@@ -482,32 +716,55 @@ void panel_icon_grid_set_aspect_width(PanelIconGrid * ig, gboolean aspect_width)
     gtk_widget_queue_resize(GTK_WIDGET(ig));
 } */
 
+/* Update cached positions of elements from..to inclusive. */
+static void panel_icon_grid_renumber(PanelIconGrid *ig, guint from, guint to)
+{
+    guint i;
+
+    for (i = from; i <= to && i < ig->children->len; i++)
+        g_hash_table_insert(ig->child_index, g_ptr_array_index(ig->children, i),
+                            GUINT_TO_POINTER(i + 1));
+}
+
 /* Remove an icon grid element. */
 static void panel_icon_grid_remove(GtkContainer *container, GtkWidget *widget)
 {
     PanelIconGrid *ig = PANEL_ICON_GRID(container);
-    GList *children = ig->children;
-    GtkWidget *child;
+    guint position = GPOINTER_TO_UINT(g_hash_table_lookup(ig->child_index, widget));
+    gboolean was_visible;
+    guint n;
 
-    while (children)
-    {
-        child = children->data;
-        if (widget == child)
+    if (position == 0)
+        return;
+    was_visible = gtk_widget_get_visible(widget);
+
+    /* The child is found.  Remove from child list and layout container. */
+    g_signal_handlers_disconnect_by_func(widget,
+                                         panel_icon_grid_child_visible_changed,
+                                         ig);
+    panel_icon_grid_invalidate_from(ig, position - 1);
+    /* Don't keep the widget in layout used for hit testing, but keep cells
+       of others so only the ones which move are allocated. */
+    for (n = 0; n < ig->n_layout && n < position; n++)
+        if (ig->layout[n].child == widget)
         {
-            gboolean was_visible = gtk_widget_get_visible(widget);
-
-            /* The child is found.  Remove from child list and layout container. */
-            gtk_widget_unparent (widget);
-            ig->children = g_list_remove_link(ig->children, children);
-            g_list_free(children);
-
-            /* Do a relayout if needed. */
-            if (was_visible)
-                gtk_widget_queue_resize(GTK_WIDGET(ig));
+            ig->n_layout--;
+            memmove(&ig->layout[n], &ig->layout[n + 1],
+                    (ig->n_layout - n) * sizeof(IconGridLayoutItem));
+            while (ig->n_lines > 0 && ig->lines[ig->n_lines - 1].first >= n)
+                ig->n_lines--;
             break;
         }
-        children = children->next;
-    }
+    if (ig->dest_item == widget)
+        ig->dest_item = NULL;
+    gtk_widget_unparent (widget);
+    g_ptr_array_remove_index(ig->children, position - 1);
+    g_hash_table_remove(ig->child_index, widget);
+    panel_icon_grid_renumber(ig, position - 1, ig->children->len);
+
+    /* Do a relayout if needed. */
+    if (was_visible)
+        gtk_widget_queue_resize(GTK_WIDGET(ig));
 }
 
 /* Get the index of an icon grid element. Actually it's
@@ -517,44 +774,49 @@ gint panel_icon_grid_get_child_position(PanelIconGrid * ig, GtkWidget * child)
 {
     g_return_val_if_fail(PANEL_IS_ICON_GRID(ig), -1);
 
-    return g_list_index(ig->children, child);
+    return (gint)GPOINTER_TO_UINT(g_hash_table_lookup(ig->child_index, child)) - 1;
 }
 
 /* Reorder an icon grid element.
    Equivalent to gtk_container_child_set(ig, child, "position", pos, NULL) */
 void panel_icon_grid_reorder_child(PanelIconGrid * ig, GtkWidget * child, gint position)
 {
-    GList *old_link;
-    GList *new_link;
-    gint old_position;
+    gpointer *pdata;
+    guint old_position;
+    guint new_position;
 
     g_return_if_fail(PANEL_IS_ICON_GRID(ig));
     g_return_if_fail(GTK_IS_WIDGET(child));
 
-    old_link = ig->children;
-    old_position = 0;
-    while (old_link)
-    {
-        if (old_link->data == child)
-            break;
-        old_link = old_link->next;
-        old_position++;
-    }
+    old_position = GPOINTER_TO_UINT(g_hash_table_lookup(ig->child_index, child));
 
-    g_return_if_fail(old_link != NULL);
+    g_return_if_fail(old_position != 0);
 
-    if (position == old_position)
+    old_position--;
+    if (position < 0 || (guint)position >= ig->children->len)
+        new_position = ig->children->len - 1;
+    else
+        new_position = position;
+    if (new_position == old_position)
         return;
 
-    /* Remove the child from its current position. */
-    ig->children = g_list_delete_link(ig->children, old_link);
-    if (position < 0)
-        new_link = NULL;
+    /* Shift elements in between and put the child into the new position. */
+    pdata = ig->children->pdata;
+    if (new_position < old_position)
+    {
+        memmove(&pdata[new_position + 1], &pdata[new_position],
+                (old_position - new_position) * sizeof(gpointer));
+        pdata[new_position] = child;
+        panel_icon_grid_renumber(ig, new_position, old_position);
+    }
     else
-        new_link = g_list_nth(ig->children, position);
-
-    /* If the child was found, insert it at the new position. */
-    ig->children = g_list_insert_before(ig->children, new_link, child);
+    {
+        memmove(&pdata[old_position], &pdata[old_position + 1],
+                (new_position - old_position) * sizeof(gpointer));
+        pdata[new_position] = child;
+        panel_icon_grid_renumber(ig, old_position, new_position);
+    }
+    panel_icon_grid_invalidate_from(ig, MIN(old_position, new_position));
 
     /* Do a relayout. */
     if (gtk_widget_get_visible(child) && gtk_widget_get_visible(GTK_WIDGET(ig)))
@@ -565,7 +827,7 @@ guint panel_icon_grid_get_n_children(PanelIconGrid * ig)
 {
     g_return_val_if_fail(PANEL_IS_ICON_GRID(ig), 0);
 
-    return g_list_length(ig->children);
+    return ig->children->len;
 }
 
 /* Change the geometry of an icon grid. */
@@ -587,6 +849,7 @@ void panel_icon_grid_set_geometry(PanelIconGrid * ig,
     ig->child_height = child_height;
     ig->spacing = MAX(spacing, 1);
     ig->target_dimension = MAX(target_dimension, 0);
+    panel_icon_grid_invalidate_layout(ig);
     gtk_widget_queue_resize(GTK_WIDGET(ig));
 
 }
@@ -612,6 +875,43 @@ void panel_icon_grid_force_redraw (PanelIconGrid * ig)
     gtk_widget_queue_resize (GTK_WIDGET (ig));
 }
 
+/* Find the first row or column which isn't completely passed when scanning
+   the layout for coordinates. Rows and columns are placed with constant
+   pitch so the guess is exact unless some children have reduced size. */
+static guint panel_icon_grid_find_line(PanelIconGrid *ig, gint x, gint y,
+                                       gboolean rtl)
+{
+    gint coord, offset, pitch;
+    guint i;
+
+#define LINE_PASSED(_i) ((ig->orientation == GTK_ORIENTATION_HORIZONTAL && rtl) ? \
+                         (ig->lines[_i].start > coord) : (ig->lines[_i].end <= coord))
+    if (ig->n_lines == 0)
+        return 0;
+    if (ig->orientation == GTK_ORIENTATION_HORIZONTAL)
+    {
+        coord = x;
+        pitch = ig->layout_child_width + ig->spacing;
+        if (rtl)
+            offset = ig->lines[0].end - coord;
+        else
+            offset = coord - ig->lines[0].start;
+    }
+    else
+    {
+        coord = y;
+        pitch = ig->layout_child_height + ig->spacing;
+        offset = coord - ig->lines[0].start;
+    }
+    i = (pitch > 0 && offset > 0) ? MIN((guint)(offset / pitch), ig->n_lines) : 0;
+    while (i > 0 && !LINE_PASSED(i - 1))
+        i--;
+    while (i < ig->n_lines && LINE_PASSED(i))
+        i++;
+#undef LINE_PASSED
+    return i;
+}
+
 /* get position for coordinates, return FALSE if it's outside of icon grid */
 gboolean panel_icon_grid_get_dest_at_pos(PanelIconGrid * ig, gint x, gint y,
                                          GtkWidget ** child, PanelIconGridDropPosition * pos)
@@ -619,7 +919,7 @@ gboolean panel_icon_grid_get_dest_at_pos(PanelIconGrid * ig, gint x, gint y,
     GtkAllocation allocation;
     PanelIconGridDropPosition drop_pos;
     GtkWidget *widget;
-    GList *ige;
+    guint i;
     gboolean rtl, upper = TRUE;
 
     g_return_val_if_fail(PANEL_IS_ICON_GRID(ig), FALSE);
@@ -631,11 +931,14 @@ gboolean panel_icon_grid_get_dest_at_pos(PanelIconGrid * ig, gint x, gint y,
         return FALSE;
 
     rtl = (gtk_widget_get_direction(widget) == GTK_TEXT_DIR_RTL);
+    /* Items before the found line are all passed so start checks from it. */
+    i = panel_icon_grid_find_line(ig, x, y, rtl);
+    i = (i < ig->n_lines) ? ig->lines[i].first : ig->n_layout;
     if (ig->orientation == GTK_ORIENTATION_HORIZONTAL)
     {
-        for (ige = ig->children; ige != NULL; ige = ige->next)
+        for (; i < ig->n_layout; i++)
         {
-            gtk_widget_get_allocation(ige->data, &allocation);
+            allocation = ig->layout[i].allocation;
             if (x < allocation.x)
             {
                 if (!rtl)
@@ -675,9 +978,9 @@ gboolean panel_icon_grid_get_dest_at_pos(PanelIconGrid * ig, gint x, gint y,
     }
     else
     {
-        for (ige = ig->children; ige != NULL; ige = ige->next)
+        for (; i < ig->n_layout; i++)
         {
-            gtk_widget_get_allocation(ige->data, &allocation);
+            allocation = ig->layout[i].allocation;
             if (y < allocation.y)
             {
                     /* reached next row */
@@ -718,10 +1021,13 @@ gboolean panel_icon_grid_get_dest_at_pos(PanelIconGrid * ig, gint x, gint y,
             }
         }
     }
-    if (ige == NULL)
+    if (i < ig->n_layout)
+        widget = ig->layout[i].child;
+    else
     {
         /* not within allocated space */
-        ige = g_list_last(ig->children);
+        widget = (ig->children->len == 0) ? NULL :
+                    g_ptr_array_index(ig->children, ig->children->len - 1);
         if (ig->orientation != GTK_ORIENTATION_HORIZONTAL)
             drop_pos = PANEL_ICON_GRID_DROP_BELOW;
         else if (rtl)
@@ -730,7 +1036,7 @@ gboolean panel_icon_grid_get_dest_at_pos(PanelIconGrid * ig, gint x, gint y,
             drop_pos = PANEL_ICON_GRID_DROP_RIGHT_AFTER;
     }
     if (child)
-        *child = (ige == NULL) ? NULL : ige->data;
+        *child = widget;
     if (pos)
         *pos = drop_pos;
     return TRUE;
@@ -817,7 +1123,7 @@ void panel_icon_grid_set_drag_dest(PanelIconGrid * ig, GtkWidget * child,
     ig->dest_pos = pos;
 
     // remember new state
-    if (child && g_list_find(ig->children, child))
+    if (child && g_hash_table_lookup(ig->child_index, child))
     {
         ig->dest_item = child;
         panel_icon_grid_queue_draw_child(ig, child);
@@ -852,6 +1158,7 @@ static void panel_icon_grid_set_property(GObject *object, guint prop_id,
         if (orientation != ig->orientation)
         {
             ig->orientation = orientation;
+            panel_icon_grid_invalidate_layout(ig);
             gtk_widget_queue_resize(GTK_WIDGET(ig));
         }
         break;
@@ -860,6 +1167,7 @@ static void panel_icon_grid_set_property(GObject *object, guint prop_id,
         if (spacing != ig->spacing)
         {
             ig->spacing = spacing;
+            panel_icon_grid_invalidate_layout(ig);
             g_object_notify(object, "spacing");
             gtk_widget_queue_resize(GTK_WIDGET(ig));
         }
@@ -1118,14 +1426,16 @@ static void panel_icon_grid_forall(GtkContainer *container,
                                    gpointer      callback_data)
 {
     PanelIconGrid *ig = PANEL_ICON_GRID(container);
-    GList *children = ig->children;
     GtkWidget *child;
+    guint i = 0;
 
-    while (children)
+    while (i < ig->children->len)
     {
-        child = children->data;
-        children = children->next;
+        child = g_ptr_array_index(ig->children, i);
         (* callback)(child, callback_data);
+        /* The callback may remove the child from the grid. */
+        if (i < ig->children->len && g_ptr_array_index(ig->children, i) == child)
+            i++;
     }
 }
 
@@ -1172,6 +1482,18 @@ static void panel_icon_grid_get_child_property(GtkContainer *container,
     }
 }
 
+static void panel_icon_grid_finalize(GObject *object)
+{
+    PanelIconGrid *ig = PANEL_ICON_GRID(object);
+
+    g_free(ig->layout);
+    g_free(ig->lines);
+    g_hash_table_destroy(ig->child_index);
+    g_ptr_array_free(ig->children, TRUE);
+
+    G_OBJECT_CLASS(panel_icon_grid_parent_class)->finalize(object);
+}
+
 static void panel_icon_grid_class_init(PanelIconGridClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
@@ -1180,6 +1502,7 @@ static void panel_icon_grid_class_init(PanelIconGridClass *klass)
 
     object_class->set_property = panel_icon_grid_set_property;
     object_class->get_property = panel_icon_grid_get_property;
+    object_class->finalize = panel_icon_grid_finalize;
 
 #if GTK_CHECK_VERSION(3, 0, 0)
     widget_class->get_preferred_width = panel_icon_grid_get_preferred_width;
@@ -1246,6 +1569,8 @@ static void panel_icon_grid_init(PanelIconGrid *ig)
     gtk_widget_set_redraw_on_allocate(GTK_WIDGET(ig), FALSE);
 
     ig->orientation = GTK_ORIENTATION_HORIZONTAL;
+    ig->children = g_ptr_array_new();
+    ig->child_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 /* Establish an icon grid in a specified container widget.
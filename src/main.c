@@ -58,6 +58,7 @@
 #include "lxpanelctl.h"
 #include "dbg.h"
 #include "space.h"
+#include "startup-trace.h"
 
 static gchar *cfgfile = NULL;
 static gchar version[] = VERSION;
@@ -116,7 +117,7 @@ static void process_client_msg ( XClientMessageEvent* ev )
                 for (pl = plugins; pl; pl = pl->next)
                 {
                     const LXPanelPluginInit *init = PLUGIN_CLASS(pl->data);
-                    if (init->show_system_menu)
+                    if (init->show_system_menu && !PLUGIN_IS_PLACEHOLDER(pl->data))
                         /* queue to show system menu */
                         init->show_system_menu(pl->data);
                 }
@@ -248,8 +249,13 @@ static void process_client_msg ( XClientMessageEvent* ev )
                                         {
                                             if (init == PLUGIN_CLASS(pl->data))
                                             {
+                                                GtkWidget *plugin = pl->data;
+
+                                                if (PLUGIN_IS_PLACEHOLDER (plugin))
+                                                    plugin = _lxpanel_construct_placeholder (plugin);
                                                 sprintf (buf, "mtw%d\n", val);
-                                                init->control (pl->data, buf);
+                                                if (plugin && PLUGIN_CLASS (plugin)->control)
+                                                    PLUGIN_CLASS (plugin)->control (plugin, buf);
                                                 break;
                                             }
                                         }
@@ -326,7 +332,10 @@ static void process_client_msg ( XClientMessageEvent* ev )
                             }
                             g_list_free (plugins);
 
-                            if (plugin && init->control) init->control (plugin, command);
+                            if (plugin && PLUGIN_IS_PLACEHOLDER (plugin))
+                                plugin = _lxpanel_construct_placeholder (plugin);
+                            if (plugin && PLUGIN_CLASS (plugin)->control)
+                                PLUGIN_CLASS (plugin)->control (plugin, command);
                         }
                     }
                 }
@@ -387,9 +396,14 @@ static void process_client_msg ( XClientMessageEvent* ev )
                     if (plugin != NULL)
                         lxpanel_remove_plugin(p, plugin);
                 }
-                /* send the command */
-                else if (plugin && init->control)
-                    init->control(plugin, command);
+                /* send the command, deferred plugin should be created first */
+                else if (plugin)
+                {
+                    if (PLUGIN_IS_PLACEHOLDER(plugin))
+                        plugin = _lxpanel_construct_placeholder(plugin);
+                    if (plugin && PLUGIN_CLASS(plugin)->control)
+                        PLUGIN_CLASS(plugin)->control(plugin, command);
+                }
             } while(0);
             g_free(plugin_type);
             break;
@@ -467,33 +481,33 @@ panel_event_filter(GdkXEvent *xevent, GdkEvent *event, gpointer not_used)
     {
         if (at == a_NET_CLIENT_LIST)
         {
-            fb_ev_emit(fbev, EV_CLIENT_LIST);
+            fb_ev_queue(fbev, EV_CLIENT_LIST);
         }
         else if (at == a_NET_CURRENT_DESKTOP)
         {
             GSList* l;
             for( l = all_panels; l; l = l->next )
                 ((LXPanel*)l->data)->priv->curdesk = get_net_current_desktop();
-            fb_ev_emit(fbev, EV_CURRENT_DESKTOP);
+            fb_ev_queue(fbev, EV_CURRENT_DESKTOP);
         }
         else if (at == a_NET_NUMBER_OF_DESKTOPS)
         {
             GSList* l;
             for( l = all_panels; l; l = l->next )
                 ((LXPanel*)l->data)->priv->desknum = get_net_number_of_desktops();
-            fb_ev_emit(fbev, EV_NUMBER_OF_DESKTOPS);
+            fb_ev_queue(fbev, EV_NUMBER_OF_DESKTOPS);
         }
         else if (at == a_NET_DESKTOP_NAMES)
         {
-            fb_ev_emit(fbev, EV_DESKTOP_NAMES);
+            fb_ev_queue(fbev, EV_DESKTOP_NAMES);
         }
         else if (at == a_NET_ACTIVE_WINDOW)
         {
-            fb_ev_emit(fbev, EV_ACTIVE_WINDOW );
+            fb_ev_queue(fbev, EV_ACTIVE_WINDOW );
         }
         else if (at == a_NET_CLIENT_LIST_STACKING)
         {
-            fb_ev_emit(fbev, EV_CLIENT_LIST_STACKING);
+            fb_ev_queue(fbev, EV_CLIENT_LIST_STACKING);
         }
         else if (at == a_XROOTPMAP_ID)
         {
@@ -509,6 +523,21 @@ panel_event_filter(GdkXEvent *xevent, GdkEvent *event, gpointer not_used)
     return GDK_FILTER_CONTINUE;
 }
 
+/* Keeps X properties cache in sync. It should be the first filter to be
+   called so any other filters see updated values, therefore it's added
+   for all windows before any plugin is created. */
+static GdkFilterReturn
+panel_xprop_cache_filter(GdkXEvent *xevent, GdkEvent *event, gpointer not_used)
+{
+    XEvent *ev = (XEvent *) xevent;
+
+    if (ev->type == PropertyNotify)
+        _xprop_cache_invalidate(ev->xproperty.window, ev->xproperty.atom);
+    else if (ev->type == DestroyNotify)
+        xprop_cache_forget(ev->xdestroywindow.window);
+    return GDK_FILTER_CONTINUE;
+}
+
 /* The same for new plugins type - they will be not unloaded by FmModule */
 #define REGISTER_STATIC_MODULE(pc) do { \
     extern LXPanelPluginInit lxpanel_static_plugin_##pc; \
@@ -730,14 +759,24 @@ static void _ensure_user_config_dirs(void)
     g_free(dir);
 }
 
+/* runs once all startup work is done */
+static gboolean startup_trace_idle(gpointer unused)
+{
+    startup_trace_mark("idle", NULL);
+    startup_trace_dump();
+    return FALSE;
+}
+
 int main(int argc, char *argv[], char *env[])
 {
     int i;
     const char* desktop_name;
+    gint64 start;
 #if !GTK_CHECK_VERSION(3, 0, 0)
     char *file;
 #endif
 
+    startup_trace_init();
     setlocale(LC_CTYPE, "");
 
 #if !GLIB_CHECK_VERSION(2, 32, 0)
@@ -746,8 +785,10 @@ int main(int argc, char *argv[], char *env[])
 /*    gdk_threads_init();
     gdk_threads_enter(); */
 
+    start = startup_trace_begin();
     gtk_init(&argc, &argv);
     keybinder_init();
+    startup_trace_end("gtk_init", NULL, start);
 
 #ifdef ENABLE_NLS
     bindtextdomain ( GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR );
@@ -823,9 +864,11 @@ int main(int argc, char *argv[], char *env[])
     fm_gtk_init(NULL);
 
     /* prepare modules data */
+    start = startup_trace_begin();
     lxpanel_prepare_modules();
     lxpanel_register_plugin_type("space", &_lxpanel_static_plugin_space);
     init_static_plugins();
+    startup_trace_end("modules", NULL, start);
 
     load_global_config();
 
@@ -834,10 +877,15 @@ int main(int argc, char *argv[], char *env[])
      */
     gdk_window_set_events(gdk_get_default_root_window(), GDK_STRUCTURE_MASK |
             GDK_SUBSTRUCTURE_MASK | GDK_PROPERTY_CHANGE_MASK);
+    gdk_window_add_filter(NULL, (GdkFilterFunc)panel_xprop_cache_filter, NULL);
     gdk_window_add_filter(gdk_get_default_root_window (), (GdkFilterFunc)panel_event_filter, NULL);
 
+    start = startup_trace_begin();
     if( G_UNLIKELY( ! start_all_panels() ) )
         g_warning( "Config files are not found.\n" );
+    startup_trace_end("panels", NULL, start);
+    if (startup_trace_enabled)
+        g_idle_add_full(G_PRIORITY_LOW + 10, startup_trace_idle, NULL, NULL);
 
     lxpanel_notify_init (first_panel);
     g_idle_add (check_user_warnings, first_panel);
@@ -850,6 +898,7 @@ int main(int argc, char *argv[], char *env[])
 
     XSelectInput (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), GDK_ROOT_WINDOW(), NoEventMask);
     gdk_window_remove_filter(gdk_get_default_root_window (), (GdkFilterFunc)panel_event_filter, NULL);
+    gdk_window_remove_filter(NULL, (GdkFilterFunc)panel_xprop_cache_filter, NULL);
 
     /* destroy all panels */
     g_slist_foreach( all_panels, (GFunc) gtk_widget_destroy, NULL );
@@ -857,7 +906,13 @@ int main(int argc, char *argv[], char *env[])
     all_panels = NULL;
     g_free( cfgfile );
 
+    /* write all config changes which are still pending */
+    lxpanel_config_flush();
+    startup_trace_dump();
+
     free_global_config();
+    _xprop_cache_free();
+    lxpanel_metrics_cleanup();
 
     lxpanel_unload_modules();
     fm_gtk_finalize();
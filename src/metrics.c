@@ -0,0 +1,189 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "metrics.h"
+#include "private.h"
+
+#include <glib/gstdio.h>
+
+#define METRICS_HISTORY 60          /* readings kept for each metric */
+#define METRICS_WRITE_DELAY 1       /* seconds */
+
+typedef struct {
+    char *name;
+    char *unit;
+    gint64 time;                    /* monotonic time of the latest reading */
+    double values[METRICS_HISTORY]; /* circular, latest at head - 1 */
+    guint head;
+    guint count;
+} Metric;
+
+static GHashTable *metrics_by_name = NULL;
+static GPtrArray *metrics = NULL;   /* in order of first publishing */
+static GString *metrics_buf = NULL; /* reused for each write */
+static char *metrics_path = NULL;
+static guint metrics_timer = 0;
+
+gboolean lxpanel_metrics_enabled(void)
+{
+    return lxpanel_export_metrics;
+}
+
+static Metric *_metrics_get(const char *name, const char *unit)
+{
+    Metric *m;
+
+    if (metrics_by_name == NULL)
+    {
+        metrics_by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        metrics = g_ptr_array_new();
+    }
+    m = g_hash_table_lookup(metrics_by_name, name);
+    if (m != NULL)
+        return m;
+    m = g_new0(Metric, 1);
+    m->name = g_strdup(name);
+    m->unit = g_strdup(unit);
+    /* keep the line protocol parseable */
+    g_strdelimit(m->name, " \t\n", '_');
+    g_strdelimit(m->unit, " \t\n", '_');
+    /* lookup is by original name */
+    g_hash_table_insert(metrics_by_name, g_strdup(name), m);
+    g_ptr_array_add(metrics, m);
+    return m;
+}
+
+static void _metrics_append_value(GString *str, double value)
+{
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    /* not locale dependent, unlike printf */
+    g_string_append(str, g_ascii_formatd(buf, sizeof(buf), "%.6g", value));
+}
+
+static gboolean _metrics_write(gpointer unused)
+{
+    gint64 now_real, now;
+    GError *err = NULL;
+    Metric *m;
+    char *dir;
+    guint i, j;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    metrics_timer = 0;
+
+    if (metrics_path == NULL)
+    {
+        dir = g_build_filename(g_get_user_runtime_dir(), "lxpanel", NULL);
+        g_mkdir_with_parents(dir, 0700);
+        metrics_path = g_strdup_printf("%s/%s.metrics", dir, cprofile);
+        g_free(dir);
+        metrics_buf = g_string_sized_new(1024);
+    }
+
+    now_real = g_get_real_time();
+    now = g_get_monotonic_time();
+    g_string_assign(metrics_buf, "# lxpanel metrics 1\n"
+                    "# name unit time_ms value history\n");
+    for (i = 0; i < metrics->len; i++)
+    {
+        m = g_ptr_array_index(metrics, i);
+        g_string_append_printf(metrics_buf, "%s %s %" G_GINT64_FORMAT " ",
+                               m->name, m->unit,
+                               (now_real - (now - m->time)) / 1000);
+        _metrics_append_value(metrics_buf,
+                              m->values[(m->head + METRICS_HISTORY - 1) % METRICS_HISTORY]);
+        for (j = m->count; j > 0; j--)
+        {
+            g_string_append_c(metrics_buf, j == m->count ? ' ' : ',');
+            _metrics_append_value(metrics_buf,
+                                  m->values[(m->head + METRICS_HISTORY - j) % METRICS_HISTORY]);
+        }
+        g_string_append_c(metrics_buf, '\n');
+    }
+
+    /* it is written into temporary file and renamed over the target */
+    if (!g_file_set_contents(metrics_path, metrics_buf->str, metrics_buf->len, &err))
+    {
+        g_warning("metrics: cannot write %s: %s", metrics_path, err->message);
+        g_error_free(err);
+    }
+    return FALSE;
+}
+
+void lxpanel_metrics_publish(const char *name, const char *unit,
+                             gint64 time, double value)
+{
+    Metric *m;
+
+    if (!lxpanel_export_metrics)
+        return;
+    g_return_if_fail(name != NULL && unit != NULL);
+
+    if (time == 0)
+        time = g_get_monotonic_time();
+    m = _metrics_get(name, unit);
+    /* the same sample published again, e.g. by another plugin instance */
+    if (m->count > 0 && m->time == time)
+        m->head = (m->head + METRICS_HISTORY - 1) % METRICS_HISTORY;
+    else if (m->count < METRICS_HISTORY)
+        m->count++;
+    m->values[m->head] = value;
+    m->head = (m->head + 1) % METRICS_HISTORY;
+    m->time = time;
+
+    if (metrics_timer == 0)
+        metrics_timer = g_timeout_add_seconds(METRICS_WRITE_DELAY, _metrics_write, NULL);
+}
+
+static void _metrics_free(gpointer data)
+{
+    Metric *m = data;
+
+    g_free(m->name);
+    g_free(m->unit);
+    g_free(m);
+}
+
+void lxpanel_metrics_cleanup(void)
+{
+    if (metrics_timer)
+        g_source_remove(metrics_timer);
+    metrics_timer = 0;
+    /* stale readings should not be taken for live ones */
+    if (metrics_path)
+        g_unlink(metrics_path);
+    g_free(metrics_path);
+    metrics_path = NULL;
+    if (metrics_buf)
+        g_string_free(metrics_buf, TRUE);
+    metrics_buf = NULL;
+    if (metrics_by_name)
+    {
+        g_hash_table_destroy(metrics_by_name);
+        g_ptr_array_foreach(metrics, (GFunc)_metrics_free, NULL);
+        g_ptr_array_free(metrics, TRUE);
+    }
+    metrics_by_name = NULL;
+    metrics = NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * lxpanel_metrics_enabled
+ *
+ * Checks if export of metrics is enabled by the ExportMetrics option in
+ * the [Config] group of the global config. Plugins may use it to skip
+ * preparing values which are needed only for export.
+ *
+ * Returns: %TRUE if lxpanel_metrics_publish() records values.
+ *
+ * Since: 0.10.2
+ */
+extern gboolean lxpanel_metrics_enabled(void);
+
+/**
+ * lxpanel_metrics_publish
+ * @name: name of metric, such as "cpu.load"; whitespace is replaced by '_'
+ * @unit: unit of @value, such as "%" or "MHz"
+ * @time: monotonic time of the reading in microseconds, or 0 for now
+ * @value: the reading
+ *
+ * Records new reading of a metric if export is enabled. The latest
+ * reading and a short history of each metric are written at most once a
+ * second into file $XDG_RUNTIME_DIR/lxpanel/<profile>.metrics, one line
+ * per metric:
+ *
+ * <name> <unit> <time in ms since epoch> <value> <history, oldest first>
+ *
+ * where history is a comma separated list. Lines starting with '#' are
+ * comments. The file is replaced atomically so readers never see it half
+ * written. Readings with the same @time replace each other, so several
+ * plugin instances may publish the same sample.
+ *
+ * Since: 0.10.2
+ */
+extern void lxpanel_metrics_publish(const char *name, const char *unit,
+                                    gint64 time, double value);
+
+G_END_DECLS
+
+#endif /* __METRICS_H__ */
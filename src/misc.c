@@ -39,6 +39,10 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <libfm/fm-gtk.h>
+#ifdef HAVE_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
 
 #include "misc.h"
 #include "private.h"
@@ -481,6 +485,351 @@ Xclimsgwm(Window win, Atom type, Atom arg)
     XSendEvent(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, False, 0L, (XEvent *) &xev);
 }
 
+/* -----------------------------------------------------------------------------
+ * Per-window X properties cache.
+ *
+ * Windows are added into cache by xprop_cache_prefetch() which reads all the
+ * properties we commonly need for a window list in one pass, and then each
+ * get_*() helper below is served from cache instead of doing a round trip to
+ * the X server. Entries are dropped on PropertyNotify (which is guaranteed
+ * since PropertyChangeMask is selected on window before it is cached) and
+ * the window is forgotten on DestroyNotify, see panel_xprop_cache_filter().
+ * If lxpanel is built with XCB then xprop_cache_prefetch() sends requests
+ * for all windows at once and collects replies afterwards, so the main loop
+ * waits for single round trip instead of one per window and property.
+ */
+
+typedef struct {
+    Atom prop;                  /* property name */
+    Atom req_type;              /* type requested by caller */
+    Atom type;                  /* actual type, None if property isn't set */
+    int format;
+    gulong nitems;
+    guchar *data;               /* copy of property data, may be NULL */
+} XPropCacheEntry;
+
+typedef struct {
+    GSList *entries;            /* XPropCacheEntry */
+} XPropCacheWindow;
+
+static GHashTable *xprop_cache = NULL; /* Window -> XPropCacheWindow */
+
+static gsize xprop_data_size(int format, gulong nitems)
+{
+    /* see XGetWindowProperty(3): 32-bit data are stored as longs */
+    switch (format)
+    {
+    case 32:
+        return nitems * sizeof(long);
+    case 16:
+        return nitems * sizeof(short);
+    default:
+        return nitems;
+    }
+}
+
+static void xprop_cache_entry_free(XPropCacheEntry *entry)
+{
+    g_free(entry->data);
+    g_slice_free(XPropCacheEntry, entry);
+}
+
+static void xprop_cache_window_free(XPropCacheWindow *cw)
+{
+    g_slist_free_full(cw->entries, (GDestroyNotify)xprop_cache_entry_free);
+    g_slice_free(XPropCacheWindow, cw);
+}
+
+static inline XPropCacheWindow *xprop_cache_window_lookup(Window win)
+{
+    if (xprop_cache == NULL)
+        return NULL;
+    return g_hash_table_lookup(xprop_cache, GUINT_TO_POINTER(win));
+}
+
+/* Returns copy of property data which can be freed with XFree(), the same
+   way as data returned by XGetWindowProperty(). Xlib always appends a
+   terminating zero byte to the data so we do the same. */
+static guchar *xprop_cache_entry_dup_data(XPropCacheEntry *entry)
+{
+    gsize size;
+    guchar *data;
+
+    if (entry->data == NULL)
+        return NULL;
+    size = xprop_data_size(entry->format, entry->nitems);
+    data = malloc(size + 1); /* XFree() is free() */
+    if (data != NULL)
+    {
+        memcpy(data, entry->data, size);
+        data[size] = '\0';
+    }
+    return data;
+}
+
+/* adds entry into cache, data should be allocated by g_malloc() */
+static void xprop_cache_window_take(XPropCacheWindow *cw, Atom prop, Atom req_type,
+                                    Atom type, int format, gulong nitems,
+                                    gpointer data)
+{
+    XPropCacheEntry *entry = g_slice_new(XPropCacheEntry);
+
+    entry->prop = prop;
+    entry->req_type = req_type;
+    entry->type = type;
+    entry->format = format;
+    entry->nitems = nitems;
+    entry->data = data;
+    cw->entries = g_slist_prepend(cw->entries, entry);
+}
+
+static void xprop_cache_window_store(XPropCacheWindow *cw, Atom prop, Atom req_type,
+                                     Atom type, int format, gulong nitems,
+                                     guchar *data)
+{
+    if (data != NULL && type != None)
+        xprop_cache_window_take(cw, prop, req_type, type, format, nitems,
+                                g_memdup(data, xprop_data_size(format, nitems)));
+    else
+        xprop_cache_window_take(cw, prop, req_type, type, format, nitems, NULL);
+}
+
+/* Wrapper over XGetWindowProperty() reading whole property either from
+   cache if window is cached, or from X server otherwise. */
+static int xprop_cache_get_property(Display *xdisplay, Window win, Atom prop,
+                                    Atom req_type, Atom *type, int *format,
+                                    gulong *nitems, guchar **data)
+{
+    XPropCacheWindow *cw = xprop_cache_window_lookup(win);
+    XPropCacheEntry *entry;
+    gulong bytes_after;
+    GSList *l;
+    int result;
+
+    if (cw != NULL) for (l = cw->entries; l; l = l->next)
+    {
+        entry = l->data;
+        if (entry->prop == prop && entry->req_type == req_type)
+        {
+            *type = entry->type;
+            *format = entry->format;
+            *nitems = entry->nitems;
+            *data = xprop_cache_entry_dup_data(entry);
+            return Success;
+        }
+    }
+    *data = NULL;
+    result = XGetWindowProperty(xdisplay, win, prop, 0, G_MAXLONG, False,
+                                req_type, type, format, nitems, &bytes_after,
+                                data);
+    if (result == Success && cw != NULL)
+        xprop_cache_window_store(cw, prop, req_type, *type, *format, *nitems, *data);
+    return result;
+}
+
+/* we need PropertyNotify and DestroyNotify to keep cache valid, use the
+   same mask as taskbar does; do not change event mask of gtk windows
+   spawned by this gtk client, this breaks gtk internals */
+#define XPROP_CACHE_EVENT_MASK (PropertyChangeMask | StructureNotifyMask)
+
+static inline gboolean xprop_cache_is_foreign(GdkDisplay *display, Window win)
+{
+#if GTK_CHECK_VERSION(2, 24, 0)
+    return (gdk_x11_window_lookup_for_display(display, win) == NULL);
+#else
+    return (gdk_window_lookup(win) == NULL);
+#endif
+}
+
+/* properties used by taskbar, pager and others for any client */
+#define XPROP_CACHE_PROPS { \
+        { a_NET_WM_STATE, XA_ATOM }, \
+        { a_NET_WM_WINDOW_TYPE, XA_ATOM }, \
+        { a_NET_WM_DESKTOP, XA_CARDINAL }, \
+        { a_NET_WM_PID, XA_CARDINAL }, \
+        { a_NET_WM_VISIBLE_NAME, a_UTF8_STRING }, \
+        { a_NET_WM_NAME, a_UTF8_STRING }, \
+        { a_WM_STATE, a_WM_STATE }, \
+        { XA_WM_HINTS, XA_WM_HINTS } \
+    }
+
+#ifdef HAVE_XCB
+/* converts property reply into the same layout XGetWindowProperty() uses */
+static gpointer xprop_cache_data_from_reply(xcb_get_property_reply_t *reply,
+                                            gulong *nitems)
+{
+    int len = xcb_get_property_value_length(reply);
+    gpointer value = xcb_get_property_value(reply);
+    gulong i;
+
+    *nitems = (reply->format > 0) ? len / (reply->format / 8) : 0;
+    if (reply->type == XCB_ATOM_NONE || *nitems == 0)
+        return NULL;
+    if (reply->format == 32)
+    {
+        long *data = g_new(long, *nitems);
+
+        for (i = 0; i < *nitems; i++)
+            data[i] = ((uint32_t *)value)[i];
+        return data;
+    }
+    if (reply->format == 16)
+    {
+        short *data = g_new(short, *nitems);
+
+        for (i = 0; i < *nitems; i++)
+            data[i] = ((uint16_t *)value)[i];
+        return data;
+    }
+    return g_memdup(value, len);
+}
+
+static void xprop_cache_fetch(GdkDisplay *display, Window *list, gint n,
+                              XPropCacheWindow **cws)
+{
+    xcb_connection_t *c = XGetXCBConnection(GDK_DISPLAY_XDISPLAY(display));
+    xcb_void_cookie_t *select_cookies = g_new(xcb_void_cookie_t, n);
+    const Atom props[][2] = XPROP_CACHE_PROPS;
+    const gint n_props = G_N_ELEMENTS(props);
+    xcb_get_property_cookie_t *cookies = g_new(xcb_get_property_cookie_t,
+                                               n * n_props);
+    uint32_t mask = XPROP_CACHE_EVENT_MASK;
+    xcb_get_property_reply_t *reply;
+    xcb_generic_error_t *error;
+    gulong nitems;
+    gint i, j;
+
+    /* send all the requests first ... */
+    for (i = 0; i < n; i++)
+    {
+        if (xprop_cache_is_foreign(display, list[i]))
+            select_cookies[i] = xcb_change_window_attributes_checked(c, list[i],
+                                                XCB_CW_EVENT_MASK, &mask);
+        else
+            select_cookies[i].sequence = 0;
+        for (j = 0; j < n_props; j++)
+            cookies[i * n_props + j] =
+                xcb_get_property(c, 0, list[i], props[j][0], props[j][1],
+                                 0, G_MAXUINT32 / 4);
+    }
+    /* ... then collect replies; errors are checked so they will not get
+       into Xlib error handler, windows may be destroyed already */
+    for (i = 0; i < n; i++)
+    {
+        if (select_cookies[i].sequence != 0)
+        {
+            error = xcb_request_check(c, select_cookies[i]);
+            free(error);
+        }
+        for (j = 0; j < n_props; j++)
+        {
+            error = NULL;
+            reply = xcb_get_property_reply(c, cookies[i * n_props + j],
+                                           &error);
+            if (reply != NULL)
+            {
+                gpointer data = xprop_cache_data_from_reply(reply, &nitems);
+
+                xprop_cache_window_take(cws[i], props[j][0], props[j][1],
+                                        reply->type, reply->format, nitems,
+                                        data);
+                free(reply);
+            }
+            free(error);
+        }
+    }
+    g_free(cookies);
+    g_free(select_cookies);
+}
+#else
+static void xprop_cache_fetch(GdkDisplay *display, Window *list, gint n,
+                              XPropCacheWindow **cws)
+{
+    Display *xdisplay = GDK_DISPLAY_XDISPLAY(display);
+    XErrorHandler previous_error_handler;
+    const Atom props[][2] = XPROP_CACHE_PROPS;
+    Atom type;
+    int format;
+    gulong nitems;
+    guchar *data;
+    gint i;
+    guint j;
+
+    /* windows in the list may be destroyed already, ignore that */
+    previous_error_handler = XSetErrorHandler(panel_handle_x_error_swallow_BadWindow_BadDrawable);
+    for (i = 0; i < n; i++)
+    {
+        if (xprop_cache_is_foreign(display, list[i]))
+            XSelectInput(xdisplay, list[i], XPROP_CACHE_EVENT_MASK);
+        for (j = 0; j < G_N_ELEMENTS(props); j++)
+            if (xprop_cache_get_property(xdisplay, list[i], props[j][0], props[j][1],
+                                         &type, &format, &nitems, &data) == Success
+                && data != NULL)
+                XFree(data);
+    }
+    XSetErrorHandler(previous_error_handler);
+}
+#endif
+
+void xprop_cache_prefetch(Window *list, gint n)
+{
+    Window *fetch;
+    XPropCacheWindow **cws;
+    gint i, n_fetch = 0;
+
+    if (xprop_cache == NULL)
+        xprop_cache = g_hash_table_new_full(g_direct_hash, NULL, NULL,
+                                            (GDestroyNotify)xprop_cache_window_free);
+    fetch = g_new(Window, n);
+    cws = g_new(XPropCacheWindow *, n);
+    for (i = 0; i < n; i++)
+    {
+        if (g_hash_table_lookup(xprop_cache, GUINT_TO_POINTER(list[i])) != NULL)
+            continue; /* already cached or duplicate */
+        cws[n_fetch] = g_slice_new0(XPropCacheWindow);
+        g_hash_table_insert(xprop_cache, GUINT_TO_POINTER(list[i]), cws[n_fetch]);
+        fetch[n_fetch++] = list[i];
+    }
+    if (n_fetch > 0)
+        xprop_cache_fetch(gdk_display_get_default(), fetch, n_fetch, cws);
+    g_free(cws);
+    g_free(fetch);
+}
+
+void xprop_cache_forget(Window win)
+{
+    if (xprop_cache != NULL)
+        g_hash_table_remove(xprop_cache, GUINT_TO_POINTER(win));
+}
+
+void _xprop_cache_invalidate(Window win, Atom prop)
+{
+    XPropCacheWindow *cw = xprop_cache_window_lookup(win);
+    GSList *l, *next;
+
+    if (cw == NULL)
+        return;
+    for (l = cw->entries; l; l = next)
+    {
+        XPropCacheEntry *entry = l->data;
+
+        next = l->next;
+        if (entry->prop == prop)
+        {
+            cw->entries = g_slist_delete_link(cw->entries, l);
+            xprop_cache_entry_free(entry);
+        }
+    }
+}
+
+void _xprop_cache_free(void)
+{
+    if (xprop_cache != NULL)
+        g_hash_table_destroy(xprop_cache);
+    xprop_cache = NULL;
+}
+
+
 
 void *
 get_utf8_property(Window win, Atom atom)
@@ -488,16 +837,14 @@ get_utf8_property(Window win, Atom atom)
     Atom type;
     int format;
     gulong nitems;
-    gulong bytes_after;
     gchar *val, *retval;
     int result;
     guchar *tmp = NULL;
 
     type = None;
     retval = NULL;
-    result = XGetWindowProperty (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, atom, 0, G_MAXLONG, False,
-          a_UTF8_STRING, &type, &format, &nitems,
-          &bytes_after, &tmp);
+    result = xprop_cache_get_property(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, atom,
+          a_UTF8_STRING, &type, &format, &nitems, &tmp);
     if (result != Success || type == None)
         return NULL;
     val = (gchar *) tmp;
@@ -516,15 +863,13 @@ get_utf8_property_list(Window win, Atom atom, int *count)
     Atom type;
     int format;
     gulong nitems, i;
-    gulong bytes_after;
     gchar *s, **retval = NULL;
     int result;
     guchar *tmp = NULL;
 
     *count = 0;
-    result = XGetWindowProperty(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, atom, 0, G_MAXLONG, False,
-          a_UTF8_STRING, &type, &format, &nitems,
-          &bytes_after, &tmp);
+    result = xprop_cache_get_property(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, atom,
+          a_UTF8_STRING, &type, &format, &nitems, &tmp);
     if (result != Success || type != a_UTF8_STRING || tmp == NULL)
         return NULL;
 
@@ -561,14 +906,12 @@ get_xaproperty (Window win, Atom prop, Atom type, int *nitems)
     Atom type_ret;
     int format_ret;
     unsigned long items_ret;
-    unsigned long after_ret;
     unsigned char *prop_data;
 
     ENTER;
     prop_data = NULL;
-    if (XGetWindowProperty (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, prop, 0, G_MAXLONG, False,
-              type, &type_ret, &format_ret, &items_ret,
-              &after_ret, &prop_data) != Success || items_ret == 0)
+    if (xprop_cache_get_property(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, prop,
+              type, &type_ret, &format_ret, &items_ret, &prop_data) != Success || items_ret == 0)
     {
         if( G_UNLIKELY(prop_data) )
             XFree( prop_data );
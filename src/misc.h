@@ -134,6 +134,34 @@ void get_net_wm_state(Window win, NetWMState *nws);
 void get_net_wm_window_type(Window win, NetWMWindowType *nwwt);
 GPid get_net_wm_pid(Window win);
 
+/**
+ * xprop_cache_prefetch
+ * @list: array of X windows
+ * @n: number of windows in @list
+ *
+ * Starts tracking properties of windows from @list which aren't tracked
+ * yet and reads all properties commonly used for window lists (state,
+ * window type, desktop, pid, names, WM_STATE and WM_HINTS) at once. After
+ * that get_xaproperty(), get_utf8_property() and other helpers above will
+ * be served from the cache for those windows until the property changes.
+ * The cache is kept valid by the panel core, no action is required from
+ * callers, but they may call xprop_cache_forget() when the window is of no
+ * interest anymore.
+ *
+ * Since: 0.10.2
+ */
+extern void xprop_cache_prefetch(Window *list, gint n);
+
+/**
+ * xprop_cache_forget
+ * @win: X window
+ *
+ * Stops tracking properties of @win and frees cached data for it.
+ *
+ * Since: 0.10.2
+ */
+extern void xprop_cache_forget(Window win);
+
 /**
  * panel_handle_x_error
  * @d: X display
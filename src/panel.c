@@ -61,6 +61,7 @@
 #include "lxpanelctl.h"
 #include "dbg.h"
 #include "gtk-compat.h"
+#include "startup-trace.h"
 
 gchar *cprofile = "default";
 
@@ -219,6 +220,8 @@ static void lxpanel_finalize(GObject *object)
 
     if( p->config_changed )
         lxpanel_config_save( self );
+    /* the panel is going away, don't leave the save scheduled */
+    panel_config_flush(p);
     config_destroy(p->config);
 
     //XFree(p->workarea);
@@ -1524,9 +1527,12 @@ static void panel_popupmenu_delete_panel( GtkMenuItem* item, LXPanel* panel )
         gchar *fname;
         all_panels = g_slist_remove( all_panels, panel );
 
+        /* let queued save finish so it doesn't restore the file */
+        panel_config_flush(panel->priv);
         /* delete the config file of this panel */
         fname = _user_config_file_name("panels", panel->priv->name);
         g_unlink( fname );
+        config_remove_cache(fname);
         g_free(fname);
         panel->priv->config_changed = 0;
         gtk_widget_destroy(GTK_WIDGET(panel));
@@ -1630,12 +1636,12 @@ GtkMenu* lxpanel_get_plugin_menu( LXPanel* panel, GtkWidget* plugin, gboolean us
         gtk_image_menu_item_set_image( (GtkImageMenuItem*)menu_item, img );
 #endif
         gtk_menu_shell_prepend(GTK_MENU_SHELL(ret), menu_item);
-        if( init->config )
+        if( init->config && !PLUGIN_IS_PLACEHOLDER(plugin) )
             g_signal_connect( menu_item, "activate", G_CALLBACK(panel_popupmenu_config_plugin), plugin );
         else
             gtk_widget_set_sensitive( menu_item, FALSE );
         /* add custom items by plugin if requested */
-        if (init->update_context_menu != NULL)
+        if (init->update_context_menu != NULL && !PLUGIN_IS_PLACEHOLDER(plugin))
             use_sub_menu = init->update_context_menu(plugin, ret);
         /* append a separator */
         menu_item = gtk_separator_menu_item_new();
@@ -1837,6 +1843,10 @@ panel_parse_plugin(LXPanel *p, config_setting_t *cfg)
     config_setting_lookup_string(cfg, "type", &type);
     DBG("plug %s\n", type);
 
+    /* non-critical plugins will be created once panel is shown */
+    if (type && lxpanel_defer_plugins &&
+        _lxpanel_add_plugin_placeholder(p, type, cfg) != NULL)
+        RET(1);
     if (!type || lxpanel_add_plugin(p, type, cfg, -1) == NULL) {
         g_warning( "lxpanel: can't load %s plugin", type);
         goto error;
@@ -1847,6 +1857,24 @@ error:
     RET(0);
 }
 
+static gboolean _trace_panel_mapped(GtkWidget *w, GdkEvent *event, gpointer unused)
+{
+    g_signal_handlers_disconnect_by_func(w, _trace_panel_mapped, unused);
+    startup_trace_mark("map", LXPANEL(w)->priv->name);
+    return FALSE;
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _trace_panel_painted(GtkWidget *w, cairo_t *cr, gpointer unused)
+#else
+static gboolean _trace_panel_painted(GtkWidget *w, GdkEventExpose *event, gpointer unused)
+#endif
+{
+    g_signal_handlers_disconnect_by_func(w, _trace_panel_painted, unused);
+    startup_trace_mark("paint", LXPANEL(w)->priv->name);
+    return FALSE;
+}
+
 static void
 panel_start_gui(LXPanel *panel, config_setting_t *list)
 {
@@ -1864,6 +1892,15 @@ panel_start_gui(LXPanel *panel, config_setting_t *list)
     ENTER;
 
     g_debug("panel_start_gui on '%s'", p->name);
+    if (startup_trace_enabled)
+    {
+        g_signal_connect(w, "map-event", G_CALLBACK(_trace_panel_mapped), NULL);
+#if GTK_CHECK_VERSION(3, 0, 0)
+        g_signal_connect_after(w, "draw", G_CALLBACK(_trace_panel_painted), NULL);
+#else
+        g_signal_connect_after(w, "expose-event", G_CALLBACK(_trace_panel_painted), NULL);
+#endif
+    }
     p->curdesk = get_net_current_desktop();
     p->desknum = get_net_number_of_desktops();
     //p->workarea = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_WORKAREA, XA_CARDINAL, &p->wa_len);
@@ -2148,7 +2185,8 @@ static gboolean _panel_idle_reconfigure(gpointer widget)
     for( l = plugins; l; l = l->next ) {
         GtkWidget *w = (GtkWidget*)l->data;
         const LXPanelPluginInit *init = PLUGIN_CLASS(w);
-        if (init->reconfigure)
+        /* deferred plugin will be created with current settings anyway */
+        if (init->reconfigure && !PLUGIN_IS_PLACEHOLDER(w))
             init->reconfigure(panel, w);
     }
     g_list_free(plugins);
@@ -2323,14 +2361,21 @@ void panel_destroy(Panel *p)
 LXPanel* panel_new( const char* config_file, const char* config_name )
 {
     LXPanel* panel = NULL;
+    gint64 start;
+    gboolean ok;
 
     if (G_LIKELY(config_file))
     {
         panel = panel_allocate(gdk_screen_get_default());
         panel->priv->name = g_strdup(config_name);
         g_debug("starting panel from file %s",config_file);
-        if (!config_read_file(panel->priv->config, config_file) ||
-            !panel_start(panel))
+        start = startup_trace_begin();
+        if (lxpanel_config_cache)
+            ok = config_read_file_cached(panel->priv->config, config_file);
+        else
+            ok = config_read_file(panel->priv->config, config_file);
+        startup_trace_end("config", config_name, start);
+        if (!ok || !panel_start(panel))
         {
             g_warning( "lxpanel: can't start panel");
             gtk_widget_destroy(GTK_WIDGET(panel));
@@ -2347,13 +2392,21 @@ LXPanel* panel_new( const char* config_file, const char* config_name )
 LXPanel* panel_new_mon_fb (const char* config_file, const char* config_name)
 {
     LXPanel* panel = NULL;
+    gint64 start;
+    gboolean ok;
 
     if (G_LIKELY(config_file))
     {
         panel = panel_allocate (gdk_screen_get_default ());
         panel->priv->name = g_strdup (config_name);
         g_debug ("starting panel from file %s", config_file);
-        if (!config_read_file (panel->priv->config, config_file))
+        start = startup_trace_begin ();
+        if (lxpanel_config_cache)
+            ok = config_read_file_cached (panel->priv->config, config_file);
+        else
+            ok = config_read_file (panel->priv->config, config_file);
+        startup_trace_end ("config", config_name, start);
+        if (!ok)
         {
             g_warning ( "lxpanel: can't start panel");
             gtk_widget_destroy (GTK_WIDGET(panel));
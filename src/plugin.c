@@ -30,6 +30,7 @@
 #include <gdk/gdk.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include "misc.h"
 
@@ -41,6 +42,8 @@
 #include "private.h"
 #include "dbg.h"
 #include "gtk-compat.h"
+#include "startup-trace.h"
+#include "graph-history.h"
 
 #if GTK_CHECK_VERSION(3, 0, 0)
 #include <gtk/gtkx.h>
@@ -52,8 +55,13 @@ GQuark lxpanel_plugin_qinit;
 GQuark lxpanel_plugin_qconf;
 GQuark lxpanel_plugin_qdata;
 GQuark lxpanel_plugin_qsize;
+GQuark lxpanel_plugin_qplaceholder;
 static GHashTable *_all_types = NULL;
 
+/* placeholders of plugins which construction was postponed */
+static GQueue _deferred_plugins = G_QUEUE_INIT;
+static guint _deferred_plugins_idle = 0;
+
 /* Dynamic parameter for static (built-in) plugins must be FALSE so we will not try to unload them */
 #define REGISTER_STATIC_PLUGIN_CLASS(pc) \
 do {\
@@ -158,32 +166,330 @@ static void plugin_class_unref(PluginClass * pc)
     }
 }
 
-/* Loads all available old type plugins. Should be removed in future releases. */
-static void plugin_get_available_classes(void)
-{
 #ifndef DISABLE_PLUGINS_LOADING
-    GDir * dir = g_dir_open(PACKAGE_LIB_DIR "/lxpanel/plugins", 0, NULL);
-    if (dir != NULL)
+#define PLUGINS_DIR PACKAGE_LIB_DIR "/lxpanel/plugins"
+#define MANIFEST_VERSION 1
+#define MANIFEST_GROUP "Manifest"
+#define MANIFEST_PLUGIN_PREFIX "Plugin "
+
+/* Plugin module which is known from manifest but not loaded yet. Its stub
+   is listed in _all_types until the module is loaded and registered. */
+typedef struct {
+    LXPanelPluginInit init;     /* stub: only name, description and flags */
+    char *type;
+    char *path;
+    gint64 mtime;               /* of module file, to check manifest validity */
+    gint64 size;
+    gboolean legacy;            /* module contains old type PluginClass */
+} LazyPlugin;
+
+static GHashTable *_lazy_plugins = NULL; /* type -> LazyPlugin */
+
+static LazyPlugin *_lazy_plugin_new(const char *type, const char *path,
+                                    const LXPanelPluginInit *init, gboolean legacy)
+{
+    LazyPlugin *lazy = g_new0(LazyPlugin, 1);
+
+    lazy->type = g_strdup(type);
+    lazy->path = g_strdup(path);
+    lazy->legacy = legacy;
+    if (init != NULL)
+    {
+        lazy->init.name = g_strdup(init->name);
+        lazy->init.description = g_strdup(init->description);
+        lazy->init.gettext_package = g_strdup(init->gettext_package);
+        lazy->init.one_per_system = init->one_per_system;
+        lazy->init.expand_available = init->expand_available;
+        lazy->init.expand_default = init->expand_default;
+        lazy->init.superseded = init->superseded;
+        lazy->init.non_critical = init->non_critical;
+    }
+    return lazy;
+}
+
+static void _lazy_plugin_free(gpointer data)
+{
+    LazyPlugin *lazy = data;
+
+    g_free(lazy->init.name);
+    g_free(lazy->init.description);
+    g_free(lazy->init.gettext_package);
+    g_free(lazy->type);
+    g_free(lazy->path);
+    g_free(lazy);
+}
+
+static inline gboolean _is_lazy_stub(const char *name, const LXPanelPluginInit *init)
+{
+    LazyPlugin *lazy;
+
+    if (_lazy_plugins == NULL)
+        return FALSE;
+    lazy = g_hash_table_lookup(_lazy_plugins, name);
+    return (lazy != NULL && init == &lazy->init);
+}
+
+/* Opens module once to get its metadata for manifest. */
+static LazyPlugin *_lazy_plugin_probe(const char *path, const char *file)
+{
+    LazyPlugin *lazy = NULL;
+    GModule *m;
+    gpointer name, ver, sym;
+    PluginClass *pc;
+    struct stat st;
+
+    if (stat(path, &st) < 0)
+        return NULL;
+    m = g_module_open(path, G_MODULE_BIND_LAZY);
+    if (m == NULL)
+    {
+        g_warning("%s", g_module_error());
+        return NULL;
+    }
+    if (g_module_symbol(m, "module_name", &name) && name != NULL &&
+        g_module_symbol(m, "module_lxpanel_gtk_version", &ver) && ver != NULL &&
+        *(int *)ver == FM_MODULE_lxpanel_gtk_VERSION &&
+        g_module_symbol(m, "fm_module_init_lxpanel_gtk", &sym) && sym != NULL &&
+        ((LXPanelPluginInit *)sym)->new_instance != NULL)
+    {
+        lazy = _lazy_plugin_new(name, path, sym, FALSE);
+    }
+    else
     {
-        const char * file;
-        while ((file = g_dir_read_name(dir)) != NULL)
+        /* Formulate the name of the expected external variable of type PluginClass. */
+        char class_name[128];
+        char *type = g_strndup(file, strlen(file) - 3);
+
+        g_snprintf(class_name, sizeof(class_name), "%s_plugin_class", type);
+        if (g_module_symbol(m, class_name, &sym) && (pc = sym) != NULL &&
+            pc->structure_size == sizeof(PluginClass) &&
+            pc->structure_version == PLUGINCLASS_VERSION &&
+            strcmp(type, pc->type) == 0)
         {
-            if (g_str_has_suffix(file, ".so"))
-            {
-                char * type = g_strndup(file, strlen(file) - 3);
-                if (_find_plugin(type) == NULL)
-                {
-                    /* If it has not been loaded, do it.  If successful, add it to the result. */
-                    char * path = g_build_filename(PACKAGE_LIB_DIR "/lxpanel/plugins", file, NULL );
-                    plugin_load_dynamic(type, path);
-                    g_free(path);
-                }
-                g_free(type);
-            }
+            lazy = _lazy_plugin_new(type, path, NULL, TRUE);
+            lazy->init.name = g_strdup(pc->name);
+            lazy->init.description = g_strdup(pc->description);
+            lazy->init.one_per_system = pc->one_per_system;
+            lazy->init.expand_available = pc->expand_available;
+            lazy->init.expand_default = pc->expand_default;
+        }
+        else
+            g_warning("%s is not a lxpanel plugin", file);
+        g_free(type);
+    }
+    g_module_close(m);
+    if (lazy != NULL)
+    {
+        lazy->mtime = st.st_mtime;
+        lazy->size = st.st_size;
+    }
+    return lazy;
+}
+
+static char *_plugin_manifest_file(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "lxpanel", "plugins.manifest", NULL);
+}
+
+/* Reads manifest into _lazy_plugins. Returns FALSE if manifest is missing
+   or any of plugin modules was changed since it was written. */
+static gboolean _plugin_manifest_read(void)
+{
+    GKeyFile *kf = g_key_file_new();
+    char *file = _plugin_manifest_file();
+    char *dir, **groups;
+    const char *group;
+    LazyPlugin *lazy;
+    struct stat st;
+    gboolean ok = FALSE;
+    int i;
+
+    if (!g_key_file_load_from_file(kf, file, G_KEY_FILE_NONE, NULL) ||
+        g_key_file_get_integer(kf, MANIFEST_GROUP, "Version", NULL) != MANIFEST_VERSION)
+        goto out;
+    dir = g_key_file_get_string(kf, MANIFEST_GROUP, "Directory", NULL);
+    ok = (g_strcmp0(dir, PLUGINS_DIR) == 0);
+    g_free(dir);
+    /* directory is changed if any module was added or removed */
+    if (!ok || stat(PLUGINS_DIR, &st) < 0 ||
+        st.st_mtime != g_key_file_get_int64(kf, MANIFEST_GROUP, "Mtime", NULL))
+    {
+        ok = FALSE;
+        goto out;
+    }
+    groups = g_key_file_get_groups(kf, NULL);
+    for (i = 0; ok && groups[i] != NULL; i++)
+    {
+        group = groups[i];
+        if (!g_str_has_prefix(group, MANIFEST_PLUGIN_PREFIX))
+            continue;
+        lazy = _lazy_plugin_new(&group[sizeof(MANIFEST_PLUGIN_PREFIX) - 1],
+                                NULL, NULL, FALSE);
+        lazy->path = g_key_file_get_string(kf, group, "Path", NULL);
+        lazy->mtime = g_key_file_get_int64(kf, group, "Mtime", NULL);
+        lazy->size = g_key_file_get_int64(kf, group, "Size", NULL);
+        if (lazy->path == NULL || stat(lazy->path, &st) < 0 ||
+            st.st_mtime != lazy->mtime || st.st_size != lazy->size)
+        {
+            _lazy_plugin_free(lazy);
+            ok = FALSE;
+            break;
+        }
+        lazy->legacy = g_key_file_get_boolean(kf, group, "Legacy", NULL);
+        lazy->init.name = g_key_file_get_string(kf, group, "Name", NULL);
+        lazy->init.description = g_key_file_get_string(kf, group, "Description", NULL);
+        lazy->init.gettext_package = g_key_file_get_string(kf, group, "GettextPackage", NULL);
+        lazy->init.one_per_system = g_key_file_get_boolean(kf, group, "OnePerSystem", NULL);
+        lazy->init.expand_available = g_key_file_get_boolean(kf, group, "ExpandAvailable", NULL);
+        lazy->init.expand_default = g_key_file_get_boolean(kf, group, "ExpandDefault", NULL);
+        lazy->init.superseded = g_key_file_get_boolean(kf, group, "Superseded", NULL);
+        lazy->init.non_critical = g_key_file_get_boolean(kf, group, "NonCritical", NULL);
+        g_hash_table_insert(_lazy_plugins, lazy->type, lazy);
+    }
+    g_strfreev(groups);
+    if (!ok)
+        g_hash_table_remove_all(_lazy_plugins);
+
+out:
+    g_key_file_free(kf);
+    g_free(file);
+    return ok;
+}
+
+static void _plugin_manifest_add(GKeyFile *kf, LazyPlugin *lazy)
+{
+    char *group = g_strconcat(MANIFEST_PLUGIN_PREFIX, lazy->type, NULL);
+
+    g_key_file_set_string(kf, group, "Path", lazy->path);
+    g_key_file_set_int64(kf, group, "Mtime", lazy->mtime);
+    g_key_file_set_int64(kf, group, "Size", lazy->size);
+    if (lazy->legacy)
+        g_key_file_set_boolean(kf, group, "Legacy", TRUE);
+    if (lazy->init.name)
+        g_key_file_set_string(kf, group, "Name", lazy->init.name);
+    if (lazy->init.description)
+        g_key_file_set_string(kf, group, "Description", lazy->init.description);
+    if (lazy->init.gettext_package)
+        g_key_file_set_string(kf, group, "GettextPackage", lazy->init.gettext_package);
+    if (lazy->init.one_per_system)
+        g_key_file_set_boolean(kf, group, "OnePerSystem", TRUE);
+    if (lazy->init.expand_available)
+        g_key_file_set_boolean(kf, group, "ExpandAvailable", TRUE);
+    if (lazy->init.expand_default)
+        g_key_file_set_boolean(kf, group, "ExpandDefault", TRUE);
+    if (lazy->init.superseded)
+        g_key_file_set_boolean(kf, group, "Superseded", TRUE);
+    if (lazy->init.non_critical)
+        g_key_file_set_boolean(kf, group, "NonCritical", TRUE);
+    g_free(group);
+}
+
+/* Probes all modules in plugins directory and writes new manifest. */
+static void _plugin_manifest_update(void)
+{
+    GDir *dir = g_dir_open(PLUGINS_DIR, 0, NULL);
+    GKeyFile *kf;
+    LazyPlugin *lazy;
+    const char *file;
+    char *path, *cache_dir, *data;
+    struct stat st;
+    gsize len;
+
+    if (dir == NULL)
+        return;
+    kf = g_key_file_new();
+    g_key_file_set_integer(kf, MANIFEST_GROUP, "Version", MANIFEST_VERSION);
+    g_key_file_set_string(kf, MANIFEST_GROUP, "Directory", PLUGINS_DIR);
+    if (stat(PLUGINS_DIR, &st) == 0)
+        g_key_file_set_int64(kf, MANIFEST_GROUP, "Mtime", st.st_mtime);
+    while ((file = g_dir_read_name(dir)) != NULL)
+    {
+        if (!g_str_has_suffix(file, ".so"))
+            continue;
+        path = g_build_filename(PLUGINS_DIR, file, NULL);
+        lazy = _lazy_plugin_probe(path, file);
+        g_free(path);
+        if (lazy == NULL)
+            continue;
+        if (g_hash_table_lookup(_lazy_plugins, lazy->type) != NULL)
+        {
+            g_warning("plugin %s is found more than once", lazy->type);
+            _lazy_plugin_free(lazy);
+            continue;
         }
-        g_dir_close(dir);
+        g_hash_table_insert(_lazy_plugins, lazy->type, lazy);
+        _plugin_manifest_add(kf, lazy);
+    }
+    g_dir_close(dir);
+    /* save it for the next start */
+    data = g_key_file_to_data(kf, &len, NULL);
+    path = _plugin_manifest_file();
+    cache_dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    if (!g_file_set_contents(path, data, len, NULL))
+        g_warning("cannot write plugins manifest %s", path);
+    g_free(cache_dir);
+    g_free(path);
+    g_free(data);
+    g_key_file_free(kf);
+}
+
+/* Loads module of plugin which was known from manifest only. */
+static void _lazy_plugin_load(LazyPlugin *lazy)
+{
+    GModule *m;
+    gpointer sym;
+    gint64 start = startup_trace_begin();
+
+    if (lazy->legacy)
+        plugin_load_dynamic(lazy->type, lazy->path);
+    else if ((m = g_module_open(lazy->path, G_MODULE_BIND_LAZY)) == NULL)
+        g_warning("%s", g_module_error());
+    else if (g_module_symbol(m, "fm_module_init_lxpanel_gtk", &sym) && sym != NULL &&
+             lxpanel_register_plugin_type(lazy->type, sym))
+        /* registered types are never unregistered, keep it */
+        g_module_make_resident(m);
+    else
+    {
+        g_warning("%s is not a lxpanel plugin", lazy->path);
+        g_module_close(m);
     }
+    startup_trace_end("load_module", lazy->type, start);
+}
+
+/* Placeholders get the type known when they were created, which may be the
+   stub from manifest, so they are updated when the module is loaded. */
+static void _update_placeholders(const LXPanelPluginInit *stub, const LXPanelPluginInit *init)
+{
+    GList *l;
+
+    for (l = _deferred_plugins.head; l; l = l->next)
+        if (PLUGIN_CLASS(l->data) == stub)
+            g_object_set_qdata(G_OBJECT(l->data), lxpanel_plugin_qinit, (gpointer)init);
+}
 #endif
+
+/* Returns plugin type, loading its module if it's not loaded yet. */
+static const LXPanelPluginInit *_get_plugin(const char *name)
+{
+    const LXPanelPluginInit *init = _find_plugin(name);
+#ifndef DISABLE_PLUGINS_LOADING
+    LazyPlugin *lazy;
+
+    if (init == NULL || !_is_lazy_stub(name, init))
+        return init;
+    lazy = (LazyPlugin *)init;
+    _lazy_plugin_load(lazy);
+    init = _find_plugin(name);
+    if (init == &lazy->init) /* failed to load, forget it */
+    {
+        g_hash_table_remove(_all_types, name);
+        init = NULL;
+    }
+    else
+        _update_placeholders(&lazy->init, init);
+#endif
+    return init;
 }
 
 /* Recursively set the background of all widgets on a panel background configuration change. */
@@ -415,8 +721,6 @@ static gboolean fm_module_callback_lxpanel_gtk(const char *name, gpointer init,
 }
 #endif
 
-static gboolean old_plugins_loaded = FALSE;
-
 void lxpanel_prepare_modules(void)
 {
     _all_types = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
@@ -424,9 +728,20 @@ void lxpanel_prepare_modules(void)
     lxpanel_plugin_qinit = g_quark_from_static_string("LXPanel::plugin-init");
     lxpanel_plugin_qconf = g_quark_from_static_string("LXPanel::plugin-conf");
     lxpanel_plugin_qsize = g_quark_from_static_string("LXPanel::plugin-size");
+    lxpanel_plugin_qplaceholder = g_quark_from_static_string("LXPanel::plugin-placeholder");
 #ifndef DISABLE_PLUGINS_LOADING
-    fm_modules_add_directory(PACKAGE_LIB_DIR "/lxpanel/plugins");
+    GHashTableIter iter;
+    LazyPlugin *lazy;
+
     fm_module_register_lxpanel_gtk();
+    /* list modules without loading them, they are loaded when used */
+    _lazy_plugins = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                          _lazy_plugin_free);
+    if (!_plugin_manifest_read())
+        _plugin_manifest_update();
+    g_hash_table_iter_init(&iter, _lazy_plugins);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&lazy))
+        g_hash_table_insert(_all_types, g_strdup(lazy->type), &lazy->init);
 #endif
 }
 
@@ -439,17 +754,27 @@ void lxpanel_unload_modules(void)
     while(g_hash_table_iter_next(&iter, &key, &val))
     {
         register const LXPanelPluginInit *init = val;
-        if (init->new_instance == NULL) /* old type of plugin */
+        /* stubs of not loaded modules have no PluginClass */
+        if (init->new_instance == NULL && init->_reserved1 != NULL) /* old type of plugin */
         {
             plugin_class_unref(init->_reserved1);
             g_free(val);
         }
     }
     g_hash_table_destroy(_all_types);
+#ifndef DISABLE_PLUGINS_LOADING
+    if (_lazy_plugins)
+        g_hash_table_destroy(_lazy_plugins);
+    _lazy_plugins = NULL;
+#endif
+    if (_deferred_plugins_idle)
+        g_source_remove(_deferred_plugins_idle);
+    _deferred_plugins_idle = 0;
+    while (!g_queue_is_empty(&_deferred_plugins))
+        g_object_unref(g_queue_pop_head(&_deferred_plugins));
 #ifndef DISABLE_PLUGINS_LOADING
     fm_module_unregister_type("lxpanel_gtk");
 #endif
-    old_plugins_loaded = FALSE;
 }
 
 gboolean lxpanel_register_plugin_type(const char *name, const LXPanelPluginInit *init)
@@ -464,8 +789,12 @@ gboolean lxpanel_register_plugin_type(const char *name, const LXPanelPluginInit
 #else
     g_static_rec_mutex_lock(&_mutex);
 #endif
-    /* test if it's registered already */
+    /* test if it's registered already, stub from manifest is replaced */
     data = _find_plugin(name);
+#ifndef DISABLE_PLUGINS_LOADING
+    if (data != NULL && _is_lazy_stub(name, data))
+        data = NULL;
+#endif
     if (data == NULL)
     {
         if (init->init)
@@ -531,10 +860,7 @@ GtkWidget *lxpanel_add_plugin(LXPanel *p, const char *name, config_setting_t *cf
     gint expand, padding = 0, border = 0, i;
 
     CHECK_MODULES();
-    if (!old_plugins_loaded)
-        plugin_get_available_classes();
-    old_plugins_loaded = TRUE;
-    init = _find_plugin(name);
+    init = _get_plugin(name);
     if (init == NULL)
         return NULL;
     /* prepare widget settings */
@@ -562,7 +888,10 @@ GtkWidget *lxpanel_add_plugin(LXPanel *p, const char *name, config_setting_t *cf
      * This causes the configuration system to avoid displaying the plugin as one that can be added. */
     if (init->new_instance) /* new style of plugin */
     {
+        gint64 start = startup_trace_begin();
+
         widget = init->new_instance(p, pconf);
+        startup_trace_end("new_instance", name, start);
         if (widget == NULL)
             return widget;
         /* always connect lxpanel_plugin_button_press_event() */
@@ -615,6 +944,95 @@ GtkWidget *lxpanel_add_plugin(LXPanel *p, const char *name, config_setting_t *cf
     return widget;
 }
 
+/* Creates the real plugin in place of placeholder right away. Returns the
+   new plugin, or NULL if it failed or placeholder was removed from panel. */
+GtkWidget *_lxpanel_construct_placeholder(GtkWidget *placeholder)
+{
+    GtkWidget *parent, *widget;
+    config_setting_t *cfg;
+    const char *type = NULL;
+    LXPanel *panel;
+    gint position = -1;
+
+    parent = gtk_widget_get_parent(placeholder);
+    cfg = g_object_get_qdata(G_OBJECT(placeholder), lxpanel_plugin_qconf);
+    if (parent == NULL || cfg == NULL)
+        return NULL;
+    panel = PLUGIN_PANEL(placeholder);
+    gtk_container_child_get(GTK_CONTAINER(parent), placeholder,
+                            "position", &position, NULL);
+    config_setting_lookup_string(cfg, "type", &type);
+    g_object_set_qdata(G_OBJECT(placeholder), lxpanel_plugin_qconf, NULL);
+    gtk_widget_destroy(placeholder);
+    widget = lxpanel_add_plugin(panel, type, cfg, position);
+    if (widget == NULL)
+    {
+        g_warning("lxpanel: can't load %s plugin", type);
+        config_setting_destroy(cfg);
+    }
+    return widget;
+}
+
+/* Creates the real plugin in place of the next queued placeholder */
+static gboolean _construct_deferred_plugin(gpointer unused)
+{
+    GtkWidget *placeholder;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    placeholder = g_queue_pop_head(&_deferred_plugins);
+    if (placeholder == NULL)
+    {
+        _deferred_plugins_idle = 0;
+        startup_trace_mark("deferred", NULL);
+        return FALSE;
+    }
+    /* it might be removed from panel or created already meanwhile */
+    _lxpanel_construct_placeholder(placeholder);
+    g_object_unref(placeholder);
+    return TRUE;
+}
+
+static void _on_placeholder_map(GtkWidget *placeholder, gpointer unused)
+{
+    g_signal_handlers_disconnect_by_func(placeholder, _on_placeholder_map, unused);
+    /* panel is on screen now, start creating plugins when idle */
+    if (_deferred_plugins_idle == 0)
+        _deferred_plugins_idle = g_idle_add_full(G_PRIORITY_LOW,
+                                                 _construct_deferred_plugin,
+                                                 NULL, NULL);
+}
+
+/* Puts an empty widget in place of non-critical plugin, the plugin itself
+   will be created after panel is mapped. Returns NULL if it cannot be
+   deferred so lxpanel_add_plugin() should be used instead. The placeholder
+   has the type of the plugin so it is found as one, but it has no plugin
+   data, so callbacks of the type may not be called for it. */
+GtkWidget *_lxpanel_add_plugin_placeholder(LXPanel *p, const char *name, config_setting_t *cfg)
+{
+    const LXPanelPluginInit *init;
+    GtkWidget *widget;
+
+    CHECK_MODULES();
+    /* stub from manifest is enough, module will be loaded later */
+    init = _find_plugin(name);
+    if (init == NULL || !init->non_critical)
+        return NULL;
+    widget = gtk_event_box_new();
+    gtk_event_box_set_visible_window(GTK_EVENT_BOX(widget), FALSE);
+    gtk_widget_set_name(widget, name);
+    gtk_box_pack_start(GTK_BOX(p->priv->box), widget, FALSE, TRUE, 0);
+    g_signal_connect(widget, "map", G_CALLBACK(_on_placeholder_map), NULL);
+    gtk_widget_show(widget);
+    g_object_set_qdata(G_OBJECT(widget), lxpanel_plugin_qconf, cfg);
+    g_object_set_qdata(G_OBJECT(widget), lxpanel_plugin_qinit, (gpointer)init);
+    g_object_set_qdata(G_OBJECT(widget), lxpanel_plugin_qplaceholder, GINT_TO_POINTER(1));
+    g_object_set_qdata_full(G_OBJECT(widget), lxpanel_plugin_qsize,
+                            g_new0(GdkRectangle, 1), g_free);
+    g_queue_push_tail(&_deferred_plugins, g_object_ref(widget));
+    return widget;
+}
+
 /* transfer none - note that not all fields are valid there */
 GHashTable *lxpanel_get_all_types(void)
 {
@@ -710,40 +1128,96 @@ const char *lxpanel_plugin_get_menu_label (GtkWidget *item)
 /* Plugin graph */
 /*----------------------------------------------------------------------------*/
 
-/* Redraw entire graph */
+#define GRAPH_ZOOM_WIDTH    120                         /* Columns of zoom in tooltip */
+#define GRAPH_ZOOM_HEIGHT   40
+#define GRAPH_ZOOM_SPAN     (3600 * G_USEC_PER_SEC)     /* Time shown by zoom */
+
+/* PluginGraph is embedded by value in external plugins, so its layout is
+ * frozen; any state added since is kept here, attached to the drawing area. */
+typedef struct {
+    char label[32];                         /* Text drawn over the graph */
+    GraphHistory *history;                  /* Multi-resolution store of all samples */
+    GtkWidget *zoom;                        /* Tooltip showing the last hour */
+} GraphPrivate;
 
-static void graph_redraw (PluginGraph *graph, char *label)
+static GQuark graph_private_quark = 0;
+
+static inline GraphPrivate *graph_priv (PluginGraph *graph)
 {
-    unsigned int fontsize, drawing_cursor, i;
-    GdkPixbuf *pixbuf;
+    return g_object_get_qdata (G_OBJECT (graph->da), graph_private_quark);
+}
 
-    cairo_t *cr = cairo_create (graph->pixmap);
-    cairo_set_line_width (cr, 1.0);
+static void graph_priv_free (gpointer data)
+{
+    GraphPrivate *priv = (GraphPrivate *) data;
+
+    graph_history_free (priv->history);
+    if (priv->zoom)
+    {
+        gtk_widget_destroy (priv->zoom);
+        g_object_unref (priv->zoom);
+    }
+    g_free (priv);
+}
 
-    /* Erase pixmap */
-    cairo_rectangle (cr, 0, 0, graph->pixmap_width, graph->pixmap_height);
-    cairo_set_source_rgba (cr, graph->background.blue, graph->background.green, graph->background.red, graph->background.alpha);
+/* Draw one column of the history surface. The surface is circular like the
+ * ring buffer, column x showing sample x, so a new point only needs its own
+ * column drawn; graph_draw puts the oldest column on the left. */
+
+static void graph_draw_column (PluginGraph *graph, cairo_t *cr, unsigned int x)
+{
+    GdkRGBA *colour;
+
+    /* Erase column, replacing rather than blending so translucent background stays as it is */
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_rectangle (cr, x, 0, 1, graph->pixmap_height);
+    gdk_cairo_set_source_rgba (cr, &graph->background);
     cairo_fill (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
 
-    /* Recompute pixmap */
-    drawing_cursor = graph->ring_cursor;
-    for (i = 0; i < graph->pixmap_width; i++)
+    /* Draw one bar of the graph. */
+    if (graph->samples[x] != 0.0)
     {
-        /* Draw one bar of the graph. */
-        if (graph->samples[drawing_cursor] != 0.0)
-        {
-            cairo_set_source_rgba (cr, graph->colours[graph->samp_states[drawing_cursor]].blue, graph->colours[graph->samp_states[drawing_cursor]].green,
-                graph->colours[graph->samp_states[drawing_cursor]].red, graph->colours[graph->samp_states[drawing_cursor]].alpha);
+        colour = &graph->colours[graph->samp_states[x]];
+        gdk_cairo_set_source_rgba (cr, colour);
+        cairo_rectangle (cr, x, graph->pixmap_height - graph->samples[x] * graph->pixmap_height, 1, graph->samples[x] * graph->pixmap_height);
+        cairo_fill (cr);
+    }
+}
 
-            cairo_move_to (cr, i + 0.5, graph->pixmap_height);
-            cairo_line_to (cr, i + 0.5, graph->pixmap_height - graph->samples[drawing_cursor] * graph->pixmap_height);
-            cairo_stroke (cr);
-        }
+/* Redraw entire history */
 
-        /* Increment and wrap drawing cursor */
-        drawing_cursor += 1;
-        if (drawing_cursor >= graph->pixmap_width) drawing_cursor = 0;
-    }
+static void graph_draw_history (PluginGraph *graph)
+{
+    unsigned int i;
+    cairo_t *cr = cairo_create (graph->pixmap);
+
+    for (i = 0; i < graph->pixmap_width; i++) graph_draw_column (graph, cr, i);
+
+    cairo_destroy (cr);
+}
+
+/* Handler for draw signal - paint history, border and label onto the drawing area */
+
+static gboolean graph_draw (GtkWidget *widget, cairo_t *cr, PluginGraph *graph)
+{
+    GtkAllocation alloc;
+    unsigned int fontsize, split;
+
+    if (graph->pixmap == NULL) return FALSE;
+
+    /* Centre graph in the allocation */
+    gtk_widget_get_allocation (widget, &alloc);
+    cairo_translate (cr, (alloc.width - (int) graph->pixmap_width) / 2, (alloc.height - (int) graph->pixmap_height) / 2);
+
+    /* Copy history, columns from the cursor onwards are the oldest */
+    split = graph->pixmap_width - graph->ring_cursor;
+    cairo_set_source_surface (cr, graph->pixmap, - (double) graph->ring_cursor, 0);
+    cairo_rectangle (cr, 0, 0, split, graph->pixmap_height);
+    cairo_fill (cr);
+    cairo_set_source_surface (cr, graph->pixmap, split, 0);
+    cairo_rectangle (cr, split, 0, graph->ring_cursor, graph->pixmap_height);
+    cairo_fill (cr);
 
     /* Draw border in black */
     cairo_set_source_rgb (cr, 0, 0, 0);
@@ -762,14 +1236,99 @@ static void graph_redraw (PluginGraph *graph, char *label)
     cairo_set_font_size (cr, fontsize);
     cairo_set_source_rgb (cr, 0, 0, 0);
     cairo_move_to (cr, (graph->pixmap_width >> 1) - ((fontsize * 5) / 4), ((graph->pixmap_height + fontsize) >> 1) - 1);
-    cairo_show_text (cr, label);
+    cairo_show_text (cr, graph_priv (graph)->label);
 
-    cairo_destroy (cr);
+    return FALSE;
+}
+
+/* Handler for draw signal of the zoom in the tooltip - paint the last hour from the history store */
+
+static gboolean graph_zoom_draw (GtkWidget *widget, cairo_t *cr, PluginGraph *graph)
+{
+    float avg[GRAPH_ZOOM_WIDTH], max[GRAPH_ZOOM_WIDTH];
+    int states[GRAPH_ZOOM_WIDTH];
+    GdkRGBA *colour;
+    unsigned int i;
+
+    graph_history_resample (graph_priv (graph)->history, g_get_monotonic_time (), GRAPH_ZOOM_SPAN, GRAPH_ZOOM_WIDTH, avg, max, states);
+
+    gdk_cairo_set_source_rgba (cr, &graph->background);
+    cairo_paint (cr);
+
+    /* Average as solid bar, peak as translucent bar above it */
+    for (i = 0; i < GRAPH_ZOOM_WIDTH; i++)
+    {
+        colour = &graph->colours[states[i]];
+        if (max[i] > avg[i])
+        {
+            cairo_set_source_rgba (cr, colour->red, colour->green, colour->blue, colour->alpha * 0.4);
+            cairo_rectangle (cr, i, (1.0 - max[i]) * GRAPH_ZOOM_HEIGHT, 1, (max[i] - avg[i]) * GRAPH_ZOOM_HEIGHT);
+            cairo_fill (cr);
+        }
+        if (avg[i] > 0.0)
+        {
+            gdk_cairo_set_source_rgba (cr, colour);
+            cairo_rectangle (cr, i, (1.0 - avg[i]) * GRAPH_ZOOM_HEIGHT, 1, avg[i] * GRAPH_ZOOM_HEIGHT);
+            cairo_fill (cr);
+        }
+    }
+
+    /* Draw border in black */
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_set_line_width (cr, 1);
+    cairo_rectangle (cr, 0.5, 0.5, GRAPH_ZOOM_WIDTH - 1, GRAPH_ZOOM_HEIGHT - 1);
+    cairo_stroke (cr);
 
-    /* Update image */
-    pixbuf = gdk_pixbuf_new_from_data (cairo_image_surface_get_data (graph->pixmap), GDK_COLORSPACE_RGB, TRUE, 8,
-        graph->pixmap_width, graph->pixmap_height, graph->pixmap_width * 4, NULL, NULL);
-    gtk_image_set_from_pixbuf (GTK_IMAGE (graph->da), pixbuf);
+    return FALSE;
+}
+
+/* Handler for query-tooltip signal - show the zoom of the last hour below the tooltip of the nearest
+ * widget that has one, so tooltips set on the plugin or its container are kept. If that widget fills in
+ * its tooltip from its own query-tooltip handler instead, leave the tooltip to it. */
+
+static gboolean graph_query_tooltip (GtkWidget *widget, gint x, gint y, gboolean keyboard, GtkTooltip *tooltip, PluginGraph *graph)
+{
+    GraphPrivate *priv = graph_priv (graph);
+    GtkWidget *label, *zoom, *w;
+    GList *children;
+    gchar *markup = NULL, *text;
+
+    for (w = widget; w != NULL; w = gtk_widget_get_parent (w))
+    {
+        markup = gtk_widget_get_tooltip_markup (w);
+        if (markup) break;
+        if (w != widget && gtk_widget_get_has_tooltip (w)) return FALSE;
+    }
+
+    if (priv->zoom == NULL)
+    {
+        priv->zoom = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+        label = gtk_label_new (NULL);
+        gtk_box_pack_start (GTK_BOX (priv->zoom), label, FALSE, FALSE, 0);
+        zoom = gtk_drawing_area_new ();
+        gtk_widget_set_size_request (zoom, GRAPH_ZOOM_WIDTH, GRAPH_ZOOM_HEIGHT);
+        g_signal_connect (zoom, "draw", G_CALLBACK (graph_zoom_draw), graph);
+        gtk_box_pack_start (GTK_BOX (priv->zoom), zoom, FALSE, FALSE, 0);
+        gtk_widget_show_all (priv->zoom);
+        g_object_ref_sink (priv->zoom);
+    }
+
+    children = gtk_container_get_children (GTK_CONTAINER (priv->zoom));
+    label = children->data;
+    g_list_free (children);
+    text = g_markup_printf_escaped ("%s", _("Last hour"));
+    if (markup)
+    {
+        gchar *tmp = g_strconcat (markup, "\n", text, NULL);
+        g_free (text);
+        text = tmp;
+    }
+    gtk_label_set_markup (GTK_LABEL (label), text);
+    g_free (text);
+    g_free (markup);
+
+    gtk_tooltip_set_custom (tooltip, priv->zoom);
+    return TRUE;
 }
 
 /* Initialise graph for a particular size */
@@ -789,51 +1348,36 @@ void graph_reload (PluginGraph *graph, int icon_size, GdkRGBA background, GdkRGB
 
     if ((new_pixmap_width > 0) && (new_pixmap_height > 0))
     {
-        /* If statistics buffer does not exist or it changed size, reallocate and preserve existing data. */
+        /* If statistics buffer does not exist or it changed size, reallocate and fill it from the history store. */
         if ((graph->samples == NULL) || (new_pixmap_width != graph->pixmap_width))
         {
             float *new_samples = g_new0 (float, new_pixmap_width);
             int *new_samp_states = g_new0 (int, new_pixmap_width);
-            if (graph->samples != NULL)
-            {
-                if (new_pixmap_width > graph->pixmap_width)
-                {
-                    /* New allocation is larger. Introduce new "oldest" samples of zero following the cursor. */
-                    memcpy (&new_samples[0], &graph->samples[0], graph->ring_cursor * sizeof (float));
-                    memcpy (&new_samples[new_pixmap_width - graph->pixmap_width + graph->ring_cursor], &graph->samples[graph->ring_cursor], (graph->pixmap_width - graph->ring_cursor) * sizeof (float));
-                    memcpy (&new_samp_states[0], &graph->samp_states[0], graph->ring_cursor * sizeof (int));
-                    memcpy (&new_samp_states[new_pixmap_width - graph->pixmap_width + graph->ring_cursor], &graph->samp_states[graph->ring_cursor], (graph->pixmap_width - graph->ring_cursor) * sizeof (int));
-                }
-                else if (graph->ring_cursor <= new_pixmap_width)
-                {
-                    /* New allocation is smaller, but still larger than the ring buffer cursor. Discard the oldest samples following the cursor. */
-                    memcpy (&new_samples[0], &graph->samples[0], graph->ring_cursor * sizeof (float));
-                    memcpy (&new_samples[graph->ring_cursor], &graph->samples[graph->pixmap_width - new_pixmap_width + graph->ring_cursor], (new_pixmap_width - graph->ring_cursor) * sizeof (float));
-                    memcpy (&new_samp_states[0], &graph->samp_states[0], graph->ring_cursor * sizeof (int));
-                    memcpy (&new_samp_states[graph->ring_cursor], &graph->samp_states[graph->pixmap_width - new_pixmap_width + graph->ring_cursor], (new_pixmap_width - graph->ring_cursor) * sizeof (int));
-                }
-                else
-                {
-                    /* New allocation is smaller, and also smaller than the ring buffer cursor. Discard all oldest samples following the ring buffer cursor and additional samples at the beginning of the buffer. */
-                    memcpy (&new_samples[0], &graph->samples[graph->ring_cursor - new_pixmap_width], new_pixmap_width * sizeof (float));
-                    memcpy (&new_samp_states[0], &graph->samp_states[graph->ring_cursor - new_pixmap_width], new_pixmap_width * sizeof (int));
-                    graph->ring_cursor = 0;
-                }
-                g_free (graph->samples);
-                g_free (graph->samp_states);
-            }
+            gint64 interval = graph_history_interval (graph_priv (graph)->history);
+
+            /* Columns older than the raw samples come from rollups; the raw samples are then copied one per column */
+            if (interval > 0)
+                graph_history_resample (graph_priv (graph)->history, g_get_monotonic_time (), interval * new_pixmap_width, new_pixmap_width, new_samples, NULL, new_samp_states);
+            graph_history_recent (graph_priv (graph)->history, new_pixmap_width, new_samples, new_samp_states);
+
+            g_free (graph->samples);
+            g_free (graph->samp_states);
             graph->samples = new_samples;
             graph->samp_states = new_samp_states;
+            graph->ring_cursor = 0;
         }
 
         /* Allocate or reallocate pixmap. */
         graph->pixmap_width = new_pixmap_width;
         graph->pixmap_height = new_pixmap_height;
         if (graph->pixmap) cairo_surface_destroy (graph->pixmap);
-        graph->pixmap = cairo_image_surface_create (CAIRO_FORMAT_RGB24, graph->pixmap_width, graph->pixmap_height);
+        graph->pixmap = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, graph->pixmap_width, graph->pixmap_height);
+        gtk_widget_set_size_request (graph->da, graph->pixmap_width, graph->pixmap_height);
 
         /* Redraw pixmap at the new size. */
-        graph_redraw (graph, "");
+        graph_draw_history (graph);
+        graph_priv (graph)->label[0] = 0;
+        gtk_widget_queue_draw (graph->da);
     }
 }
 
@@ -841,23 +1385,43 @@ void graph_reload (PluginGraph *graph, int icon_size, GdkRGBA background, GdkRGB
 
 void graph_new_point (PluginGraph *graph, float value, int state, char *label)
 {
+    cairo_t *cr;
+
     if (value < 0.0) value = 0.0;
     else if (value > 1.0) value = 1.0;
     graph->samples[graph->ring_cursor] = value;
     graph->samp_states[graph->ring_cursor] = state;
+    graph_history_add (graph_priv (graph)->history, g_get_monotonic_time (), value, state);
+
+    /* Only the new column of history changes */
+    cr = cairo_create (graph->pixmap);
+    graph_draw_column (graph, cr, graph->ring_cursor);
+    cairo_destroy (cr);
 
     graph->ring_cursor += 1;
     if (graph->ring_cursor >= graph->pixmap_width) graph->ring_cursor = 0;
 
-    graph_redraw (graph, label);
+    g_strlcpy (graph_priv (graph)->label, label ? label : "", sizeof (graph_priv (graph)->label));
+    gtk_widget_queue_draw (graph->da);
 }
 
 void graph_init (PluginGraph *graph)
 {
-    graph->da = gtk_image_new ();
+    GraphPrivate *priv;
+
+    graph->da = gtk_drawing_area_new ();
     graph->samples = NULL;
+    graph->samp_states = NULL;
     graph->ring_cursor = 0;
     graph->pixmap = NULL;
+    if (graph_private_quark == 0)
+        graph_private_quark = g_quark_from_static_string ("lxpanel-graph-private");
+    priv = g_new0 (GraphPrivate, 1);
+    priv->history = graph_history_new ();
+    g_object_set_qdata_full (G_OBJECT (graph->da), graph_private_quark, priv, graph_priv_free);
+    g_signal_connect (graph->da, "draw", G_CALLBACK (graph_draw), graph);
+    gtk_widget_set_has_tooltip (graph->da, TRUE);
+    g_signal_connect (graph->da, "query-tooltip", G_CALLBACK (graph_query_tooltip), graph);
 }
 
 void graph_free (PluginGraph *graph)
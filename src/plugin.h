@@ -104,6 +104,10 @@ G_BEGIN_DECLS
  *
  * If @gettext_package is not %NULL then it will be used for translation
  * of @name and @description. (Since: 0.9.0)
+ *
+ * If @non_critical is set then the panel may show a placeholder first and
+ * call @new_instance a bit later, once the panel is drawn, when deferred
+ * construction is enabled in the global config.
  */
 typedef struct {
     /*< public >*/
@@ -127,6 +131,7 @@ typedef struct {
     int expand_available : 1;   /* True if "stretch" option is available */
     int expand_default : 1;     /* True if "stretch" option is default */
     int superseded : 1;         /* True if plugin was superseded by another */
+    int non_critical : 1;       /* True if instance may be created after panel is shown */
 } LXPanelPluginInit; /* constant data */
 
 /*
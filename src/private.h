@@ -134,6 +134,7 @@ struct _Panel {
     guint visible : 1;
     int height_when_hidden;
     guint hide_timeout;
+    guint config_save_timer;		/* scheduled save of config */
     int icon_size;			/* Icon size */
 
     int desknum;
@@ -227,6 +228,11 @@ static inline char *_user_config_file_name(const char *name1, const char *name2)
 void load_global_config(void);
 void free_global_config(void);
 
+void panel_config_save(Panel *p);
+void panel_config_flush(Panel *p);
+void lxpanel_config_flush(void);
+guint lxpanel_config_get_coalesced_count(void);
+
 //void _queue_panel_calculate_size(Panel *panel);
 
 /* FIXME: optional definitions */
@@ -248,12 +254,23 @@ void lxpanel_unload_modules(void);
 
 GHashTable *lxpanel_get_all_types(void); /* transfer none */
 void _lxpanel_remove_plugin(LXPanel *p, GtkWidget *plugin); /* no destroy dialog */
+GtkWidget *_lxpanel_add_plugin_placeholder(LXPanel *p, const char *name, config_setting_t *cfg);
+GtkWidget *_lxpanel_construct_placeholder(GtkWidget *placeholder);
+extern gboolean lxpanel_defer_plugins; /* [Config] DeferPlugins */
+extern gboolean lxpanel_export_metrics; /* [Config] ExportMetrics */
+extern gboolean lxpanel_config_cache; /* [Config] CacheConfig */
+
+/* Metrics export */
+void lxpanel_metrics_cleanup(void);
 
 extern GQuark lxpanel_plugin_qinit; /* access to LXPanelPluginInit data */
 #define PLUGIN_CLASS(_i) ((LXPanelPluginInit*)g_object_get_qdata(G_OBJECT(_i),lxpanel_plugin_qinit))
 
 extern GQuark lxpanel_plugin_qconf; /* access to congig_setting_t data */
 
+extern GQuark lxpanel_plugin_qplaceholder; /* set on placeholder of deferred plugin */
+#define PLUGIN_IS_PLACEHOLDER(_i) (g_object_get_qdata(G_OBJECT(_i),lxpanel_plugin_qplaceholder) != NULL)
+
 #define PLUGIN_PANEL(_i) ((LXPanel*)gtk_widget_get_toplevel(_i))
 
 gboolean _class_is_present(const LXPanelPluginInit *init);
@@ -375,6 +392,10 @@ extern GdkPixbuf* lxpanel_load_icon( const char* name, int width, int height, gb
 
 void Xclimsg(Window win, Atom type, long l0, long l1, long l2, long l3, long l4);
 
+/* X properties cache maintenance, see xprop_cache_prefetch() */
+void _xprop_cache_invalidate(Window win, Atom prop);
+void _xprop_cache_free(void);
+
 
 /* Extracted from plugin.h */
 struct _Plugin;
@@ -0,0 +1,440 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "sampler.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+#define SAMPLER_PERIOD_UNIT 100 /* ms, periods are rounded to it */
+
+/* A file which is read by the sampler. Sources are never freed: there are
+   only a few of them and their descriptors are kept open for reuse. */
+typedef struct {
+    LXPanelSample sample;       /* the last reading */
+    char *key;
+    int fd;
+    char *buf;
+    gsize size;
+    LXPanelCpuTicks *cores;
+    guint cores_size;
+    guint64 tick;               /* sampler tick when it was read last time */
+} SamplerSource;
+
+typedef struct {
+    guint id;
+    SamplerSource *source;      /* NULL for LXPANEL_SAMPLE_TICK */
+    guint period;               /* ms */
+    gint64 due;                 /* monotonic time of the next sample */
+    LXPanelSampleFunc func;     /* NULL if unsubscribed while dispatching */
+    gpointer user_data;
+} SamplerSubscription;
+
+static GHashTable *sampler_sources = NULL;
+static GSList *sampler_subscriptions = NULL;
+static guint sampler_last_id = 0;
+static guint sampler_timer = 0;
+static guint sampler_tick = 0;          /* ms, period of sampler_timer */
+static guint64 sampler_ticks = 0;       /* number of wakeups so far */
+static gint64 sampler_last_tick = 0;    /* monotonic time of last wakeup */
+static gboolean sampler_dispatching = FALSE;
+static gboolean sampler_need_sweep = FALSE;
+
+static SamplerSource *_sampler_get_source(LXPanelSampleType type, const char *path)
+{
+    SamplerSource *src;
+    char *key;
+
+    if (path == NULL)
+    {
+        if (type == LXPANEL_SAMPLE_CPU)
+            path = "/proc/stat";
+        else if (type == LXPANEL_SAMPLE_MEMORY)
+            path = "/proc/meminfo";
+        else
+            return NULL;
+    }
+    if (sampler_sources == NULL)
+        sampler_sources = g_hash_table_new(g_str_hash, g_str_equal);
+    key = g_strdup_printf("%d:%s", type, path);
+    src = g_hash_table_lookup(sampler_sources, key);
+    if (src != NULL)
+    {
+        g_free(key);
+        return src;
+    }
+    src = g_new0(SamplerSource, 1);
+    src->key = key;
+    src->fd = -1;
+    src->sample.type = type;
+    src->sample.path = strchr(key, ':') + 1;
+    src->sample.text = "";
+    g_hash_table_insert(sampler_sources, key, src);
+    return src;
+}
+
+/* Parses all "cpu" lines of /proc/stat in one pass. */
+static void _sampler_parse_cpu(SamplerSource *src)
+{
+    LXPanelCpuTicks *t;
+    char *p = src->buf, *end;
+    guint i, n = 0;
+
+    memset(&src->sample.cpu, 0, sizeof(src->sample.cpu));
+    if (src->cores_size > 0)
+        memset(src->cores, 0, src->cores_size * sizeof(LXPanelCpuTicks));
+    while (strncmp(p, "cpu", 3) == 0)
+    {
+        p += 3;
+        if (*p == ' ')
+            t = &src->sample.cpu;
+        else
+        {
+            i = strtoul(p, &end, 10);
+            if (end == p)
+                break;
+            p = end;
+            if (i >= src->cores_size)
+            {
+                guint size = MAX(i + 1, src->cores_size * 2);
+
+                src->cores = g_renew(LXPanelCpuTicks, src->cores, size);
+                memset(&src->cores[src->cores_size], 0,
+                       (size - src->cores_size) * sizeof(LXPanelCpuTicks));
+                src->cores_size = size;
+            }
+            t = &src->cores[i];
+            if (i >= n)
+                n = i + 1;
+        }
+        /* fields which are missing on old kernels are read as 0 */
+        t->user = g_ascii_strtoull(p, &p, 10);
+        t->nice = g_ascii_strtoull(p, &p, 10);
+        t->system = g_ascii_strtoull(p, &p, 10);
+        t->idle = g_ascii_strtoull(p, &p, 10);
+        t->iowait = g_ascii_strtoull(p, &p, 10);
+        t->irq = g_ascii_strtoull(p, &p, 10);
+        t->softirq = g_ascii_strtoull(p, &p, 10);
+        t->steal = g_ascii_strtoull(p, &p, 10);
+        p = strchr(p, '\n');
+        if (p == NULL)
+            break;
+        p++;
+    }
+    src->sample.cores = src->cores;
+    src->sample.n_cores = n;
+    src->sample.valid = (src->sample.cpu.user + src->sample.cpu.idle > 0);
+}
+
+static const struct {
+    const char *name;
+    glong offset;
+} meminfo_fields[] = {
+    { "MemTotal:", G_STRUCT_OFFSET(LXPanelSample, mem_total) },
+    { "MemFree:", G_STRUCT_OFFSET(LXPanelSample, mem_free) },
+    { "MemAvailable:", G_STRUCT_OFFSET(LXPanelSample, mem_available) },
+    { "Buffers:", G_STRUCT_OFFSET(LXPanelSample, mem_buffers) },
+    { "Cached:", G_STRUCT_OFFSET(LXPanelSample, mem_cached) },
+    { "SReclaimable:", G_STRUCT_OFFSET(LXPanelSample, mem_sreclaimable) }
+};
+
+static void _sampler_parse_meminfo(SamplerSource *src)
+{
+    char *p = src->buf;
+    guint i, found = 0;
+
+    for (i = 0; i < G_N_ELEMENTS(meminfo_fields); i++)
+        G_STRUCT_MEMBER(gulong, &src->sample, meminfo_fields[i].offset) = 0;
+    while (found < G_N_ELEMENTS(meminfo_fields) && *p != '\0')
+    {
+        for (i = 0; i < G_N_ELEMENTS(meminfo_fields); i++)
+        {
+            gsize len = strlen(meminfo_fields[i].name);
+
+            if (strncmp(p, meminfo_fields[i].name, len) == 0)
+            {
+                G_STRUCT_MEMBER(gulong, &src->sample, meminfo_fields[i].offset) =
+                    strtoul(p + len, NULL, 10);
+                found++;
+                break;
+            }
+        }
+        p = strchr(p, '\n');
+        if (p == NULL)
+            break;
+        p++;
+    }
+    src->sample.valid = (src->sample.mem_total > 0);
+}
+
+static void _sampler_read(SamplerSource *src)
+{
+    ssize_t n;
+    gsize len = 0;
+    char *end;
+
+    src->sample.time = g_get_monotonic_time();
+    src->sample.valid = FALSE;
+    src->sample.error = 0;
+    if (src->fd < 0)
+        src->fd = open(src->sample.path, O_RDONLY | O_CLOEXEC);
+    if (src->fd < 0)
+    {
+        src->sample.error = errno;
+        return;
+    }
+    if (src->buf == NULL)
+    {
+        src->size = 1024;
+        src->buf = g_malloc(src->size);
+    }
+    /* files with many records such as /proc/net/dev return about a page
+       per read, so read until the end of file is reached */
+    for (;;)
+    {
+        if (len + 1 >= src->size)
+        {
+            src->size *= 2;
+            src->buf = g_realloc(src->buf, src->size);
+        }
+        n = pread(src->fd, src->buf + len, src->size - 1 - len, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        len += n;
+    }
+    if (n < 0)
+    {
+        /* the device may be gone, try to reopen it the next time */
+        src->sample.error = errno;
+        close(src->fd);
+        src->fd = -1;
+        src->sample.text = "";
+        src->sample.len = 0;
+        return;
+    }
+    src->buf[len] = '\0';
+    src->sample.text = src->buf;
+    src->sample.len = len;
+    switch (src->sample.type)
+    {
+    case LXPANEL_SAMPLE_CPU:
+        _sampler_parse_cpu(src);
+        break;
+    case LXPANEL_SAMPLE_MEMORY:
+        _sampler_parse_meminfo(src);
+        break;
+    case LXPANEL_SAMPLE_VALUE:
+        src->sample.value = g_ascii_strtoll(src->buf, &end, 10);
+        src->sample.valid = (end != src->buf);
+        break;
+    default:
+        src->sample.valid = TRUE;
+    }
+}
+
+static gboolean _sampler_timeout(gpointer unused);
+
+static guint _gcd(guint a, guint b)
+{
+    while (b != 0)
+    {
+        guint t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Restarts the timer if the set of periods was changed. */
+static void _sampler_update_timer(void)
+{
+    GSList *l;
+    guint tick = 0;
+
+    for (l = sampler_subscriptions; l; l = l->next)
+        tick = _gcd(tick, ((SamplerSubscription *)l->data)->period);
+    if (tick == sampler_tick)
+        return;
+    if (sampler_timer)
+        g_source_remove(sampler_timer);
+    sampler_timer = 0;
+    sampler_tick = tick;
+    if (tick == 0)
+        return;
+    sampler_last_tick = g_get_monotonic_time();
+    if (tick % 1000 == 0)
+        sampler_timer = g_timeout_add_seconds(tick / 1000, _sampler_timeout, NULL);
+    else
+        sampler_timer = g_timeout_add(tick, _sampler_timeout, NULL);
+}
+
+static void _sampler_sweep(void)
+{
+    GSList *l, *next;
+    SamplerSubscription *sub;
+
+    for (l = sampler_subscriptions; l; l = next)
+    {
+        next = l->next;
+        sub = l->data;
+        if (sub->func == NULL)
+        {
+            sampler_subscriptions = g_slist_delete_link(sampler_subscriptions, l);
+            g_slice_free(SamplerSubscription, sub);
+        }
+    }
+    sampler_need_sweep = FALSE;
+    _sampler_update_timer();
+}
+
+static gboolean _sampler_timeout(gpointer unused)
+{
+    SamplerSubscription *sub;
+    LXPanelSample tick;
+    GSList *l;
+    gint64 now, slack;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    now = g_get_monotonic_time();
+    sampler_last_tick = now;
+    sampler_ticks++;
+    /* allow half of tick for timer jitter */
+    slack = (gint64)sampler_tick * 500;
+    memset(&tick, 0, sizeof(tick));
+    tick.type = LXPANEL_SAMPLE_TICK;
+    tick.time = now;
+    tick.valid = TRUE;
+    tick.text = "";
+    sampler_dispatching = TRUE;
+    for (l = sampler_subscriptions; l; l = l->next)
+    {
+        sub = l->data;
+        if (sub->func == NULL || sub->due > now + slack)
+            continue;
+        /* keep phase even if we were late */
+        while (sub->due <= now + slack)
+            sub->due += (gint64)sub->period * 1000;
+        if (sub->source == NULL)
+        {
+            sub->func(&tick, sub->user_data);
+            continue;
+        }
+        if (sub->source->tick != sampler_ticks)
+        {
+            _sampler_read(sub->source);
+            sub->source->tick = sampler_ticks;
+        }
+        sub->func(&sub->source->sample, sub->user_data);
+    }
+    sampler_dispatching = FALSE;
+    if (sampler_need_sweep)
+        _sampler_sweep();
+    return TRUE;
+}
+
+guint lxpanel_sampler_subscribe(LXPanelSampleType type, const char *path,
+                                guint period, LXPanelSampleFunc func,
+                                gpointer user_data)
+{
+    SamplerSubscription *sub;
+    SamplerSource *src = NULL;
+
+    g_return_val_if_fail(func != NULL, 0);
+    if (type != LXPANEL_SAMPLE_TICK)
+    {
+        src = _sampler_get_source(type, path);
+        g_return_val_if_fail(src != NULL, 0);
+    }
+    sub = g_slice_new(SamplerSubscription);
+    sub->id = ++sampler_last_id;
+    sub->source = src;
+    period = (period + SAMPLER_PERIOD_UNIT / 2) / SAMPLER_PERIOD_UNIT;
+    sub->period = MAX(period, 1) * SAMPLER_PERIOD_UNIT;
+    sub->func = func;
+    sub->user_data = user_data;
+    /* new subscription is prepended so it is not dispatched right now */
+    sampler_subscriptions = g_slist_prepend(sampler_subscriptions, sub);
+    _sampler_update_timer();
+    /* put it onto the same grid as other ones */
+    sub->due = sampler_last_tick + (gint64)sub->period * 1000;
+    return sub->id;
+}
+
+void lxpanel_sampler_unsubscribe(guint id)
+{
+    GSList *l;
+    SamplerSubscription *sub;
+
+    for (l = sampler_subscriptions; l; l = l->next)
+    {
+        sub = l->data;
+        if (sub->id != id)
+            continue;
+        sub->func = NULL;
+        if (sampler_dispatching)
+            sampler_need_sweep = TRUE;
+        else
+            _sampler_sweep();
+        return;
+    }
+}
+
+const LXPanelSample *lxpanel_sampler_read(LXPanelSampleType type,
+                                          const char *path, guint max_age)
+{
+    SamplerSource *src = _sampler_get_source(type, path);
+
+    if (src == NULL)
+        return NULL;
+    if (src->sample.time == 0 ||
+        g_get_monotonic_time() - src->sample.time >= (gint64)max_age * 1000)
+        _sampler_read(src);
+    return &src->sample;
+}
+
+gfloat lxpanel_cpu_ticks_load(const LXPanelCpuTicks *prev, const LXPanelCpuTicks *cur)
+{
+    guint64 busy, idle;
+
+    /* core was offline in one of readings (its slot is zeroed then) or
+       there is no previous reading yet, nothing to compare */
+    if (cur->user < prev->user || cur->nice < prev->nice ||
+        cur->system < prev->system || cur->idle < prev->idle ||
+        prev->user + prev->nice + prev->system + prev->idle == 0)
+        return 0.0;
+    busy = (cur->user - prev->user) + (cur->nice - prev->nice) +
+           (cur->system - prev->system);
+    idle = cur->idle - prev->idle;
+    if (busy + idle == 0)
+        return 0.0;
+    return (gfloat)busy / (busy + idle);
+}
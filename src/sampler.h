@@ -0,0 +1,153 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * LXPanelSampleType:
+ * @LXPANEL_SAMPLE_TICK: no source, only aligned periodic wakeup
+ * @LXPANEL_SAMPLE_CPU: /proc/stat, total and per-core ticks
+ * @LXPANEL_SAMPLE_MEMORY: /proc/meminfo, in kB
+ * @LXPANEL_SAMPLE_VALUE: single integer from file, such as sysfs attribute
+ * @LXPANEL_SAMPLE_TEXT: whole contents of file, such as /proc/net/dev
+ *
+ * Kind of data the sampler retrieves from a source.
+ */
+typedef enum {
+    LXPANEL_SAMPLE_TICK,
+    LXPANEL_SAMPLE_CPU,
+    LXPANEL_SAMPLE_MEMORY,
+    LXPANEL_SAMPLE_VALUE,
+    LXPANEL_SAMPLE_TEXT
+} LXPanelSampleType;
+
+typedef struct {
+    guint64 user, nice, system, idle, iowait, irq, softirq, steal;
+} LXPanelCpuTicks;
+
+/**
+ * LXPanelSample:
+ * @type: kind of the sample
+ * @path: file the sample was read from
+ * @time: monotonic time of reading, in microseconds
+ * @valid: %FALSE if source could not be read
+ * @error: errno value if source could not be opened or read, 0 otherwise
+ * @cpu: sum of ticks over all cores (for %LXPANEL_SAMPLE_CPU)
+ * @cores: per-core ticks, indexed by core number (for %LXPANEL_SAMPLE_CPU)
+ * @n_cores: number of elements in @cores
+ * @mem_total: fields of /proc/meminfo (for %LXPANEL_SAMPLE_MEMORY)
+ * @value: number read (for %LXPANEL_SAMPLE_VALUE)
+ * @text: raw contents of source, nul-terminated
+ * @len: length of @text
+ *
+ * The sample is owned by the sampler and is valid only until the next
+ * reading of the same source.
+ */
+typedef struct {
+    LXPanelSampleType type;
+    const char *path;
+    gint64 time;
+    gboolean valid;
+    int error;
+    LXPanelCpuTicks cpu;
+    const LXPanelCpuTicks *cores;
+    guint n_cores;
+    gulong mem_total, mem_free, mem_available, mem_buffers, mem_cached, mem_sreclaimable;
+    gint64 value;
+    const char *text;
+    gsize len;
+} LXPanelSample;
+
+typedef void (*LXPanelSampleFunc)(const LXPanelSample *sample, gpointer user_data);
+
+/**
+ * lxpanel_sampler_subscribe
+ * @type: kind of data
+ * @path: (allow-none): file to read, may be %NULL for CPU and MEMORY
+ * @period: interval between samples, in milliseconds
+ * @func: callback to receive samples
+ * @user_data: data to pass to @func
+ *
+ * Requests periodic samples from a source. All subscriptions share a
+ * single timer which runs at the greatest common divisor of requested
+ * periods (those are rounded to 100 milliseconds), and each source is
+ * read at most once per timer wakeup regardless of number of subscribers
+ * to it. Periods which are multiple of a second use a timer that is
+ * aligned to other second based timers in the system.
+ *
+ * Returns: subscription id to use with lxpanel_sampler_unsubscribe().
+ *
+ * Since: 0.10.2
+ */
+extern guint lxpanel_sampler_subscribe(LXPanelSampleType type, const char *path,
+                                       guint period, LXPanelSampleFunc func,
+                                       gpointer user_data);
+
+/**
+ * lxpanel_sampler_unsubscribe
+ * @id: subscription id
+ *
+ * Cancels subscription made by lxpanel_sampler_subscribe(). It is safe
+ * to call it from the subscription callback.
+ *
+ * Since: 0.10.2
+ */
+extern void lxpanel_sampler_unsubscribe(guint id);
+
+/**
+ * lxpanel_sampler_read
+ * @type: kind of data
+ * @path: (allow-none): file to read, may be %NULL for CPU and MEMORY
+ * @max_age: maximum age of cached sample that may be returned, in milliseconds
+ *
+ * Retrieves sample from a source immediately, reusing the last reading
+ * if it is not older than @max_age. It may be used for initial values
+ * or by code which has its own polling schedule.
+ *
+ * Returns: (transfer none): sample or %NULL if @type is unsupported.
+ *
+ * Since: 0.10.2
+ */
+extern const LXPanelSample *lxpanel_sampler_read(LXPanelSampleType type,
+                                                 const char *path, guint max_age);
+
+/**
+ * lxpanel_cpu_ticks_load
+ * @prev: previous ticks
+ * @cur: current ticks
+ *
+ * Calculates CPU load between two readings of the same core. If @prev is
+ * all zero, or any counter in @cur is lower than in @prev, for example
+ * because the core was offline in one of the readings, there is nothing
+ * to compare and 0.0 is returned.
+ *
+ * Returns: part of time spent in user, nice and system modes, 0.0 ... 1.0.
+ *
+ * Since: 0.10.2
+ */
+extern gfloat lxpanel_cpu_ticks_load(const LXPanelCpuTicks *prev,
+                                     const LXPanelCpuTicks *cur);
+
+G_END_DECLS
+
+#endif /* __SAMPLER_H__ */
@@ -0,0 +1,154 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "startup-trace.h"
+
+#include <string.h>
+
+typedef struct {
+    char *name;
+    char *detail;
+    gint64 start;       /* monotonic time, in microseconds */
+    gint64 duration;    /* -1 for instant event */
+} TraceEvent;
+
+gboolean startup_trace_enabled = FALSE;
+
+static GArray *trace_events = NULL;
+static char *trace_file = NULL;
+static gboolean trace_chrome = FALSE;
+static gint64 trace_origin = 0;
+
+void startup_trace_init(void)
+{
+    const char *env = g_getenv("LXPANEL_TRACE");
+
+    if (env == NULL || env[0] == '\0' || startup_trace_enabled)
+        return;
+    if (strncmp(env, "chrome:", 7) == 0)
+    {
+        trace_chrome = TRUE;
+        env += 7;
+    }
+    else if (strncmp(env, "json:", 5) == 0)
+        env += 5;
+    trace_file = g_strdup(env);
+    trace_events = g_array_new(FALSE, FALSE, sizeof(TraceEvent));
+    trace_origin = g_get_monotonic_time();
+    startup_trace_enabled = TRUE;
+}
+
+static void _trace_append(const char *name, const char *detail, gint64 start,
+                          gint64 duration)
+{
+    TraceEvent ev;
+
+    ev.name = g_strdup(name);
+    ev.detail = g_strdup(detail);
+    ev.start = start;
+    ev.duration = duration;
+    g_array_append_val(trace_events, ev);
+}
+
+void startup_trace_add(const char *name, const char *detail, gint64 start)
+{
+    if (!startup_trace_enabled)
+        return;
+    _trace_append(name, detail, start, g_get_monotonic_time() - start);
+}
+
+void startup_trace_mark(const char *name, const char *detail)
+{
+    if (!startup_trace_enabled)
+        return;
+    _trace_append(name, detail, g_get_monotonic_time(), -1);
+}
+
+static void _append_json_string(GString *out, const char *str)
+{
+    g_string_append_c(out, '"');
+    if (str) for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            g_string_append_c(out, '\\');
+        else if ((guchar)*str < 0x20)
+        {
+            g_string_append_printf(out, "\\u%04x", (guchar)*str);
+            continue;
+        }
+        g_string_append_c(out, *str);
+    }
+    g_string_append_c(out, '"');
+}
+
+void startup_trace_dump(void)
+{
+    GString *out;
+    TraceEvent *ev;
+    guint i;
+
+    if (!startup_trace_enabled)
+        return;
+    out = g_string_sized_new(4096);
+    g_string_append(out, trace_chrome ? "{\"traceEvents\":[\n" : "[\n");
+    for (i = 0; i < trace_events->len; i++)
+    {
+        ev = &g_array_index(trace_events, TraceEvent, i);
+        if (trace_chrome)
+        {
+            /* complete or instant event, timestamps are in microseconds */
+            g_string_append(out, "{\"name\":");
+            _append_json_string(out, ev->name);
+            g_string_append(out, ",\"cat\":\"startup\",\"pid\":1,\"tid\":1");
+            if (ev->duration >= 0)
+                g_string_append_printf(out, ",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+                                       ",\"dur\":%" G_GINT64_FORMAT,
+                                       ev->start - trace_origin, ev->duration);
+            else
+                g_string_append_printf(out, ",\"ph\":\"i\",\"s\":\"p\",\"ts\":%"
+                                       G_GINT64_FORMAT, ev->start - trace_origin);
+            g_string_append(out, ",\"args\":{\"detail\":");
+            _append_json_string(out, ev->detail);
+            g_string_append(out, "}}");
+        }
+        else
+        {
+            g_string_append(out, "{\"name\":");
+            _append_json_string(out, ev->name);
+            g_string_append(out, ",\"detail\":");
+            _append_json_string(out, ev->detail);
+            g_string_append_printf(out, ",\"start_us\":%" G_GINT64_FORMAT,
+                                   ev->start - trace_origin);
+            if (ev->duration >= 0)
+                g_string_append_printf(out, ",\"duration_us\":%" G_GINT64_FORMAT,
+                                       ev->duration);
+            g_string_append_c(out, '}');
+        }
+        if (i + 1 < trace_events->len)
+            g_string_append_c(out, ',');
+        g_string_append_c(out, '\n');
+    }
+    g_string_append(out, trace_chrome ? "]}\n" : "]\n");
+    if (!g_file_set_contents(trace_file, out->str, out->len, NULL))
+        g_warning("cannot write startup trace into %s", trace_file);
+    g_string_free(out, TRUE);
+}
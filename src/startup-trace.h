@@ -0,0 +1,58 @@
+/*
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __STARTUP_TRACE_H__
+#define __STARTUP_TRACE_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Startup instrumentation. It is enabled by environment variable
+   LXPANEL_TRACE=[json:|chrome:]<file> and records monotonic timestamps
+   of startup stages, which are then written into the file either as a
+   plain JSON array or in Chrome trace event format. */
+
+extern gboolean startup_trace_enabled;
+
+void startup_trace_init(void);
+
+/* adds event which started at start and ends now */
+void startup_trace_add(const char *name, const char *detail, gint64 start);
+
+/* adds instant event */
+void startup_trace_mark(const char *name, const char *detail);
+
+/* writes all recorded events into the file */
+void startup_trace_dump(void);
+
+/* returns start time for startup_trace_end() */
+static inline gint64 startup_trace_begin(void)
+{
+    return G_UNLIKELY(startup_trace_enabled) ? g_get_monotonic_time() : 0;
+}
+
+static inline void startup_trace_end(const char *name, const char *detail, gint64 start)
+{
+    if (G_UNLIKELY(startup_trace_enabled))
+        startup_trace_add(name, detail, start);
+}
+
+G_END_DECLS
+
+#endif /* __STARTUP_TRACE_H__ */